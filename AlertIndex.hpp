@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "WeatherData.hpp"
+
+// The national alerts/active feed indexed by UGC code: county ("MNC053")
+// or forecast zone ("MNZ060"). One request per cycle then serves any
+// number of locations. Each location subscribes with every code it lies in
+// (county, forecast and fire weather zone), since some products name only
+// one kind. update() maps every code an alert lists (geocode.UGC and
+// affectedZones) to that alert. fanOut() then visits only the subscribers
+// of affected codes, plus those that had alerts last time so theirs can
+// expire. A cycle costs O(affected zones + matches), however many
+// locations are subscribed.
+class AlertIndex {
+ public:
+  // National feed; per-zone URLs are this plus "/zone/<code>".
+  static inline const std::string NATIONAL_URL =
+      "https://api.weather.gov/alerts/active";
+
+  // The code at the end of a zone URL, e.g. "MNC053" of
+  // https://api.weather.gov/alerts/active/zone/MNC053 or
+  // https://api.weather.gov/zones/county/MNC053.
+  static std::string zoneOf(std::string_view url) {
+    const std::size_t slash = url.find_last_of('/');
+    return std::string(slash == std::string_view::npos
+                           ? url
+                           : url.substr(slash + 1));
+  }
+
+  // Location number `location` (dense, from 0) also wants the alerts of
+  // `zone`. It gets each alert once, however many of its zones list it.
+  void subscribe(std::size_t location, const std::string& zone) {
+    if (zonesOfLocation.size() <= location) {
+      zonesOfLocation.resize(location + 1);
+      delivered.resize(location + 1, 0);
+    }
+    auto& zones = zonesOfLocation[location];
+    if (zone.empty() ||
+        std::find(zones.begin(), zones.end(), zone) != zones.end())
+      return;
+    zones.push_back(zone);
+    subscribers[zone].push_back(location);
+  }
+
+  // Replaces the index with the alerts of a national alerts/active
+  // document. Throws like bj::object::at on a document of the wrong shape,
+  // leaving the previous index in place.
+  void update(const bj::value& document) {
+    const bj::array& features =
+        document.as_object().at("features").as_array();
+    std::vector<WeatherAlert> extracted;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> zones;
+    extracted.reserve(features.size());
+    zones.reserve(byZone.size());
+    for (const auto& feature : features) {
+      const bj::object& properties =
+          feature.as_object().at("properties").as_object();
+      extracted.push_back(WeatherData::extractAlert(properties));
+      const auto index = static_cast<std::uint32_t>(extracted.size() - 1);
+      // UGC and affectedZones usually name the same codes
+      auto add = [&](std::string_view zone) {
+        if (zone.empty()) return;
+        auto& alerts = zones[std::string(zone)];
+        if (alerts.empty() || alerts.back() != index) alerts.push_back(index);
+      };
+      if (auto geocode = properties.if_contains("geocode");
+          geocode && geocode->is_object())
+        if (auto ugc = geocode->get_object().if_contains("UGC");
+            ugc && ugc->is_array())
+          for (const auto& code : ugc->get_array())
+            if (code.is_string()) add(code.get_string());
+      if (auto urls = properties.if_contains("affectedZones");
+          urls && urls->is_array())
+        for (const auto& url : urls->get_array())
+          if (url.is_string()) add(zoneOf(url.get_string()));
+    }
+    list = std::move(extracted);
+    byZone = std::move(zones);
+  }
+
+  // Calls deliver(location, std::vector<WeatherAlert>) with the current
+  // alerts of every subscriber whose alerts may have changed since the
+  // last fanOut(): those in an affected zone and those that had alerts
+  // before. Every other subscriber still has no alerts.
+  template <typename Deliver>
+  void fanOut(Deliver&& deliver) {
+    ++cycle;
+    std::vector<std::size_t> next;
+    for (const auto& entry : byZone) {
+      auto it = subscribers.find(entry.first);
+      if (it == subscribers.end()) continue;
+      for (std::size_t location : it->second) {
+        if (delivered[location] == cycle) continue;  // By another zone
+        delivered[location] = cycle;
+        next.push_back(location);
+      }
+    }
+    for (std::size_t location : next) deliver(location, alertsOf(location));
+    for (std::size_t location : alerted)
+      if (delivered[location] != cycle)
+        deliver(location, std::vector<WeatherAlert>());
+    alerted = std::move(next);
+  }
+
+  // Same for every subscriber, e.g. after they lost their alerts.
+  template <typename Deliver>
+  void fanOutAll(Deliver&& deliver) {
+    ++cycle;
+    alerted.clear();
+    for (std::size_t location = 0; location < zonesOfLocation.size();
+         location++) {
+      std::vector<WeatherAlert> alerts = alertsOf(location);
+      if (!alerts.empty()) alerted.push_back(location);
+      deliver(location, std::move(alerts));
+    }
+  }
+
+  const std::vector<WeatherAlert>& alerts() const { return list; }
+
+  // Codes with at least one alert.
+  std::size_t zones() const { return byZone.size(); }
+
+ private:
+  std::vector<WeatherAlert> list;
+  std::unordered_map<std::string, std::vector<std::uint32_t>> byZone;
+  std::unordered_map<std::string, std::vector<std::size_t>> subscribers;
+  std::vector<std::vector<std::string>> zonesOfLocation;
+  std::vector<std::size_t> alerted;  // Given alerts by the last fan-out
+  std::vector<std::uint64_t> delivered;  // Cycle a location last got alerts
+  std::uint64_t cycle{0};
+
+  // The alerts of every zone of `location`, in feed order.
+  std::vector<WeatherAlert> alertsOf(std::size_t location) const {
+    const auto& zones = zonesOfLocation[location];
+    if (zones.size() == 1) {
+      auto it = byZone.find(zones.front());
+      return it == byZone.end() ? std::vector<WeatherAlert>()
+                                : copy(it->second);
+    }
+    std::vector<std::uint32_t> indices;
+    for (const auto& zone : zones)
+      if (auto it = byZone.find(zone); it != byZone.end())
+        indices.insert(indices.end(), it->second.begin(), it->second.end());
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return copy(indices);
+  }
+
+  std::vector<WeatherAlert> copy(
+      const std::vector<std::uint32_t>& alerts) const {
+    std::vector<WeatherAlert> matched;
+    matched.reserve(alerts.size());
+    for (std::uint32_t index : alerts) matched.push_back(list[index]);
+    return matched;
+  }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "WeatherModel.hpp"
+
+// What an alert that is no longer active looked like.
+struct TrackedAlert {
+  std::string id;
+  std::string event;
+  std::string headline;
+};
+
+// Difference between two consecutive sets of active alerts. The pointers
+// refer to the alerts passed to AlertTracker::update.
+struct AlertChanges {
+  std::vector<const WeatherAlert*> added;
+  std::vector<const WeatherAlert*> updated;  // Replace an earlier alert
+  std::vector<TrackedAlert> expired;
+  std::size_t unchanged{0};
+
+  bool empty() const {
+    return added.empty() && updated.empty() && expired.empty();
+  }
+};
+
+// Remembers the active alerts of one location by NWS alert id so each cycle
+// can be reduced to what changed. An alert is "updated" when its
+// `references` name an alert we were tracking; the referenced alert is then
+// considered replaced rather than expired. Every step is a hash lookup, so
+// a cycle costs O(alerts + references).
+class AlertTracker {
+ public:
+  AlertChanges update(const std::vector<WeatherAlert>& alerts) {
+    AlertChanges changes;
+    std::unordered_set<std::string_view> current;
+    std::unordered_set<std::string_view> replaced;
+    current.reserve(alerts.size());
+    for (const auto& alert : alerts) current.insert(alert.id);
+
+    for (const auto& alert : alerts) {
+      if (active.count(alert.id)) {
+        ++changes.unchanged;
+        continue;
+      }
+      bool replaces = false;
+      for (const auto& ref : alert.references) {
+        if (active.count(ref)) {
+          replaces = true;
+          replaced.insert(ref);
+        }
+      }
+      (replaces ? changes.updated : changes.added).push_back(&alert);
+    }
+
+    for (const auto& [id, tracked] : active) {
+      if (!current.count(id) && !replaced.count(id))
+        changes.expired.push_back(tracked);
+    }
+
+    std::unordered_map<std::string, TrackedAlert> next;
+    next.reserve(alerts.size());
+    for (const auto& alert : alerts)
+      next.emplace(alert.id,
+                   TrackedAlert{alert.id, alert.event, alert.headline});
+    active = std::move(next);
+    return changes;
+  }
+
+  std::size_t size() const { return active.size(); }
+
+ private:
+  std::unordered_map<std::string, TrackedAlert> active;
+};
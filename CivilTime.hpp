@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <optional>
+#include <string>
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+// (Howard Hinnant's days_from_civil).
+inline long long daysFromCivil(int year, int month, int day) {
+  const int y = year - (month <= 2);
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const int yoe = y - era * 400;
+  const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097LL + doe - 719468;
+}
+
+// Seconds since the epoch of an ISO 8601 time the way the NWS API writes
+// them: "2026-06-13T18:00:00-05:00", "...+00:00" or "...Z".
+inline std::optional<long long> parseIsoTime(const std::string& text) {
+  int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+  int consumed = 0;
+  if (std::sscanf(text.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month,
+                  &day, &hour, &minute, &second, &consumed) != 6)
+    return std::nullopt;
+  long long seconds = daysFromCivil(year, month, day) * 86400 +
+                      hour * 3600 + minute * 60 + second;
+  const char* zone = text.c_str() + consumed;
+  // Fractional seconds are dropped
+  while (*zone == '.' || (*zone >= '0' && *zone <= '9')) ++zone;
+  int offsetHours = 0, offsetMinutes = 0;
+  if ((*zone == '+' || *zone == '-') &&
+      std::sscanf(zone + 1, "%2d:%2d", &offsetHours, &offsetMinutes) == 2) {
+    const int offset = offsetHours * 3600 + offsetMinutes * 60;
+    seconds += *zone == '+' ? -offset : offset;
+  }
+  return seconds;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <boost/program_options.hpp>
+#include <string>
+#include <vector>
 
 class CommandLineProcessor {
  private:
@@ -9,6 +11,7 @@ class CommandLineProcessor {
   static inline const int REFRESH_DELAY_MINUTES = 90;
   static inline const int RETRY_DELAY_MINUTES = 5;
   static inline const int FORECAST_PERIODS = 7;
+  static inline const int HISTORY_DAYS = 30;
 
  public:
   CommandLineProcessor(int ac, char* av[]) : desc("Allowed options") {
@@ -16,6 +19,10 @@ class CommandLineProcessor {
         "zipcode,z",
         boost::program_options::value<std::string>()->default_value("00000"),
         "US Zip code for weather forecast")(
+        "zipcodes,Z",
+        boost::program_options::value<std::vector<std::string>>()
+            ->multitoken(),
+        "Monitor several US Zip codes at once")(
         "periods,p", boost::program_options::value<int>(),
         "# of forecast periods to display")(
         "wordwrap,w",
@@ -25,7 +32,42 @@ class CommandLineProcessor {
         "retry,r",
         boost::program_options::value<int>()->default_value(
             RETRY_DELAY_MINUTES),
-        "Error retry delay in minutes");
+        "Error retry delay in minutes")(
+        "forecast-interval,f", boost::program_options::value<int>(),
+        "Forecast refresh interval in minutes (same as --delay)")(
+        "alert-interval,A", boost::program_options::value<int>(),
+        "Alert check interval in minutes (default: forecast interval)")(
+        "timing,t", boost::program_options::bool_switch(),
+        "Report connection reuse after every refresh")(
+        "once", boost::program_options::bool_switch(),
+        "Fetch and show the weather once, then exit (e.g. from cron)")(
+        "all-alerts,a", boost::program_options::bool_switch(),
+        "Show every active alert on each refresh, not only changes")(
+        "national-alerts", boost::program_options::bool_switch(),
+        "Fetch the national alert feed once per cycle for all locations "
+        "instead of one request per location")(
+        "hourly,H", boost::program_options::bool_switch(),
+        "Also fetch the hourly forecast and show the next 48 hours")(
+        "output,o",
+        boost::program_options::value<std::string>()->default_value("text"),
+        "Output format: text, or ndjson for one JSON record per poll")(
+        "serve,s", boost::program_options::value<int>(),
+        "Also serve the latest reports on 127.0.0.1:<port> as text or JSON")(
+        "api-origin", boost::program_options::value<std::string>(),
+        "Send every request to this origin instead, e.g. a mock-nws-server")(
+        "record", boost::program_options::value<std::string>(),
+        "Save every response in this directory for mock-nws-server --replay")(
+        "shared-cache", boost::program_options::value<std::string>(),
+        "Share fresh responses with other instances through this directory")(
+        "metrics", boost::program_options::value<std::string>(),
+        "Keep this file updated with Prometheus metrics of every request")(
+        "history", boost::program_options::value<std::string>(),
+        "Append every new forecast and alert list to this history file")(
+        "history-days",
+        boost::program_options::value<int>()->default_value(HISTORY_DAYS),
+        "Days of history to keep (0: keep everything)")(
+        "rules", boost::program_options::value<std::string>(),
+        "Report which rules of this file the forecast matches");
 
     boost::program_options::positional_options_description p;
     p.add("zipcode", -1);
@@ -52,6 +94,28 @@ class CommandLineProcessor {
 
   bool hasForecastPeriods() const { return argv_vm.count("periods"); }
 
+  bool hasForecastInterval() const {
+    return argv_vm.count("forecast-interval");
+  }
+
+  bool hasAlertInterval() const { return argv_vm.count("alert-interval"); }
+
+  bool hasZipCodes() const { return argv_vm.count("zipcodes"); }
+
+  bool hasServe() const { return argv_vm.count("serve"); }
+
+  bool hasApiOrigin() const { return argv_vm.count("api-origin"); }
+
+  bool hasRecord() const { return argv_vm.count("record"); }
+
+  bool hasSharedCache() const { return argv_vm.count("shared-cache"); }
+
+  bool hasMetrics() const { return argv_vm.count("metrics"); }
+
+  bool hasHistory() const { return argv_vm.count("history"); }
+
+  bool hasRules() const { return argv_vm.count("rules"); }
+
   int getDelay() const {
     int delay{REFRESH_DELAY_MINUTES};
     if (argv_vm.count("delay")) {
@@ -60,10 +124,58 @@ class CommandLineProcessor {
     return delay;
   }
 
+  int getForecastInterval() const {
+    return argv_vm["forecast-interval"].as<int>();
+  }
+
+  int getAlertInterval() const { return argv_vm["alert-interval"].as<int>(); }
+
   int getRetry() const { return argv_vm["retry"].as<int>(); }
 
   bool getWordWrap() const { return argv_vm["wordwrap"].as<bool>(); }
 
+  bool getTiming() const { return argv_vm["timing"].as<bool>(); }
+
+  bool getAllAlerts() const { return argv_vm["all-alerts"].as<bool>(); }
+
+  bool getOnce() const { return argv_vm["once"].as<bool>(); }
+
+  bool getNationalAlerts() const {
+    return argv_vm["national-alerts"].as<bool>();
+  }
+
+  bool getHourly() const { return argv_vm["hourly"].as<bool>(); }
+
+  std::string getOutput() const { return argv_vm["output"].as<std::string>(); }
+
+  int getServePort() const { return argv_vm["serve"].as<int>(); }
+
+  std::string getApiOrigin() const {
+    return argv_vm["api-origin"].as<std::string>();
+  }
+
+  std::string getRecordDirectory() const {
+    return argv_vm["record"].as<std::string>();
+  }
+
+  std::string getSharedCacheDirectory() const {
+    return argv_vm["shared-cache"].as<std::string>();
+  }
+
+  std::string getMetricsFile() const {
+    return argv_vm["metrics"].as<std::string>();
+  }
+
+  std::string getHistoryFile() const {
+    return argv_vm["history"].as<std::string>();
+  }
+
+  int getHistoryDays() const { return argv_vm["history-days"].as<int>(); }
+
+  std::string getRulesFile() const {
+    return argv_vm["rules"].as<std::string>();
+  }
+
   int getDefaultRefreshDelay() const { return REFRESH_DELAY_MINUTES; }
 
   int getDefaultRetryDelay() const { return RETRY_DELAY_MINUTES; }
@@ -82,6 +194,14 @@ class CommandLineProcessor {
     return argv_vm["zipcode"].as<std::string>();
   }
 
+  std::vector<std::string> getZipCodes() const {
+    std::vector<std::string> zipCodes;
+    if (argv_vm.count("zipcodes")) {
+      zipCodes = argv_vm["zipcodes"].as<std::vector<std::string>>();
+    }
+    return zipCodes;
+  }
+
   std::string helpMessage() const {
     std::ostringstream os;
     os << desc;
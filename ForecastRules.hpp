@@ -0,0 +1,558 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "CivilTime.hpp"
+#include "HourlyForecast.hpp"
+#include "WeatherModel.hpp"
+
+// The forecast fields rules can test, one float column each.
+enum class RuleField : std::uint8_t {
+  TEMPERATURE,    // °F
+  DEWPOINT,       // °F
+  WIND,           // mph, top of the forecast range
+  PRECIPITATION,  // Percent chance
+  DAYTIME,        // 1 or 0
+  COUNT
+};
+
+// What rules are evaluated against: the periods of one location's forecast
+// as columns, sorted by time. Taken from the hourly forecast when there is
+// one and from the 12-hour periods otherwise, whenever either changes, so
+// evaluating rules never parses text. A value the forecast leaves out is
+// NaN, which no comparison matches.
+class RuleData {
+ public:
+  static inline const float NaN = HourlyForecast::NaN;
+
+  void assign(const std::vector<ForecastPeriod>& periods) {
+    clear();
+    for (const auto& period : periods) {
+      auto start = parseIsoTime(period.startTime);
+      auto end = parseIsoTime(period.endTime);
+      if (!start || !end) continue;
+      begins.push_back(*start);
+      ends.push_back(*end);
+      const bool celsius = period.temperatureUnit == "C";
+      column(RuleField::TEMPERATURE)
+          .push_back(celsius ? HourlyForecast::toFahrenheit(period.temperature)
+                             : static_cast<float>(period.temperature));
+      column(RuleField::DEWPOINT).push_back(NaN);
+      column(RuleField::WIND)
+          .push_back(HourlyForecast::windSpeed(period.windSpeed.c_str()));
+      column(RuleField::PRECIPITATION)
+          .push_back(period.precipitationChance < 0
+                         ? NaN
+                         : static_cast<float>(period.precipitationChance));
+      column(RuleField::DAYTIME).push_back(period.isDaytime ? 1.0f : 0.0f);
+    }
+  }
+
+  void assign(const HourlyForecast& hourly) {
+    clear();
+    begins = hourly.times();
+    ends.resize(begins.size());
+    for (std::size_t i = 0; i < begins.size(); i++) ends[i] = begins[i] + 3600;
+    column(RuleField::TEMPERATURE) = hourly.temperatures();
+    column(RuleField::DEWPOINT) = hourly.dewpoints();
+    column(RuleField::WIND) = hourly.windSpeeds();
+    column(RuleField::PRECIPITATION) = hourly.precipitationChances();
+    column(RuleField::DAYTIME) = hourly.daytimes();
+  }
+
+  void clear() {
+    begins.clear();
+    ends.clear();
+    for (auto& c : columns) c.clear();
+  }
+
+  std::size_t size() const { return begins.size(); }
+
+  const std::vector<std::int64_t>& starts() const { return begins; }
+
+  const float* values(RuleField field) const {
+    return columns[static_cast<std::size_t>(field)].data();
+  }
+
+  // Periods [first, last) that overlap the `hours` hours from `now`.
+  std::pair<std::size_t, std::size_t> window(std::int64_t now,
+                                             float hours) const {
+    const auto limit = now + static_cast<std::int64_t>(hours * 3600.0f);
+    const auto first = std::upper_bound(ends.begin(), ends.end(), now);
+    const auto last = std::lower_bound(
+        begins.begin() + (first - ends.begin()), begins.end(), limit);
+    return {static_cast<std::size_t>(first - ends.begin()),
+            static_cast<std::size_t>(last - begins.begin())};
+  }
+
+ private:
+  std::vector<std::int64_t> begins;
+  std::vector<std::int64_t> ends;
+  std::array<std::vector<float>, static_cast<std::size_t>(RuleField::COUNT)>
+      columns;
+
+  std::vector<float>& column(RuleField field) {
+    return columns[static_cast<std::size_t>(field)];
+  }
+};
+
+// Site-specific triggers on the forecast, one per line of a rule file:
+//
+//   # name: expression
+//   high-wind: max(24h, wind) > 40 mph
+//   freeze-after-rain: then(48h, precipitation >= 60%, temperature <= 32)
+//   hard-freeze: count(2d, temperature < 20 F) >= 3
+//
+// A rule tests windows of the forecast from now on: any(H, e), all(H, e)
+// and count(H, e) evaluate e for each period in the next H hours, max(H, e)
+// and min(H, e) its extremes, and then(H, a, b) is true when a period
+// matching a is followed by one matching b. Inside a window e can use the
+// fields temperature, dewpoint, wind, precipitation and daytime, numbers
+// (units h, d, mph, F and % are allowed and only "d" changes the value),
+// + -, comparisons and and/or/not, which combine windows the same way.
+//
+// Each rule is compiled once into bytecode for a small stack machine;
+// evaluating it only walks that code over the RuleData columns, with no
+// parsing and no allocation.
+class RuleSet {
+ public:
+  // Deepest expression stack a rule or window may need; deeper ones are
+  // rejected when compiling.
+  static inline const std::size_t MAX_DEPTH = 32;
+
+  RuleSet() = default;
+
+  // Compiles every rule in `text`; errors throw std::runtime_error naming
+  // `source` and the line.
+  static RuleSet parse(const std::string& text,
+                       const std::string& source = "rules") {
+    RuleSet set;
+    std::istringstream in(text);
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+      ++number;
+      try {
+        set.addLine(line);
+      } catch (const std::runtime_error& e) {
+        throw std::runtime_error(source + ":" + std::to_string(number) +
+                                 ": " + e.what());
+      }
+    }
+    return set;
+  }
+
+  static RuleSet load(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) throw std::runtime_error("Cannot open rule file " + file);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return parse(text.str(), file);
+  }
+
+  std::size_t size() const { return rules.size(); }
+
+  bool empty() const { return rules.empty(); }
+
+  const std::string& name(std::size_t rule) const { return rules[rule].name; }
+
+  // Whether `rule` holds for `data` at `now` (seconds since the epoch).
+  bool matches(std::size_t rule, const RuleData& data,
+               std::int64_t now) const {
+    std::array<float, MAX_DEPTH * 2> stack;
+    const Rule& r = rules[rule];
+    return truth(run(r.begin, r.end, stack.data(), data, now, 0));
+  }
+
+ private:
+  enum class Op : std::uint8_t {
+    CONSTANT, FIELD, NEGATE, ADD, SUBTRACT,
+    LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL,
+    AND, OR, NOT,
+    ANY, ALL, COUNT, MAX, MIN, THEN
+  };
+
+  // Window ops run the code in [a, b) (and [c, d) for then) per period;
+  // `value` is the window's length in hours.
+  struct Instruction {
+    Op op;
+    RuleField field{};
+    float value{0};
+    std::uint32_t a{0}, b{0}, c{0}, d{0};
+  };
+
+  struct Rule {
+    std::string name;
+    std::uint32_t begin, end;
+  };
+
+  std::vector<Instruction> code;
+  std::vector<Rule> rules;
+
+  static bool truth(float v) { return v > 0.0f || v < 0.0f; }
+
+  float run(std::uint32_t begin, std::uint32_t end, float* stack,
+            const RuleData& data, std::int64_t now,
+            std::size_t period) const {
+    float* sp = stack;
+    for (std::uint32_t pc = begin; pc < end; pc++) {
+      const Instruction& in = code[pc];
+      switch (in.op) {
+        case Op::CONSTANT: *sp++ = in.value; break;
+        case Op::FIELD: *sp++ = data.values(in.field)[period]; break;
+        case Op::NEGATE: sp[-1] = -sp[-1]; break;
+        case Op::NOT: sp[-1] = truth(sp[-1]) ? 0.0f : 1.0f; break;
+        case Op::ANY:
+        case Op::ALL:
+        case Op::COUNT:
+        case Op::MAX:
+        case Op::MIN:
+        case Op::THEN: *sp = window(in, sp, data, now); ++sp; break;
+        default: {
+          const float y = *--sp;
+          const float x = sp[-1];
+          sp[-1] = binary(in.op, x, y);
+        }
+      }
+    }
+    return sp[-1];
+  }
+
+  static float binary(Op op, float x, float y) {
+    switch (op) {
+      case Op::ADD: return x + y;
+      case Op::SUBTRACT: return x - y;
+      case Op::LESS: return x < y;
+      case Op::LESS_EQUAL: return x <= y;
+      case Op::GREATER: return x > y;
+      case Op::GREATER_EQUAL: return x >= y;
+      case Op::EQUAL: return x == y;
+      case Op::NOT_EQUAL: return x < y || x > y;
+      case Op::AND: return truth(x) && truth(y);
+      case Op::OR: return truth(x) || truth(y);
+      default: return HourlyForecast::NaN;
+    }
+  }
+
+  // Window code that is just a field, or a field compared with a number
+  // (most of them), is read straight off the column instead of being run.
+  struct Body {
+    std::uint32_t begin, end;
+    const float* column{nullptr};
+    Op test{Op::FIELD};  // FIELD: the value itself
+    float constant{0};
+  };
+
+  Body body(std::uint32_t begin, std::uint32_t end,
+            const RuleData& data) const {
+    Body b{begin, end};
+    if (code[begin].op != Op::FIELD) return b;
+    if (end - begin == 1) {
+      b.column = data.values(code[begin].field);
+    } else if (end - begin == 3 && code[begin + 1].op == Op::CONSTANT &&
+               code[begin + 2].op >= Op::LESS &&
+               code[begin + 2].op <= Op::NOT_EQUAL) {
+      b.column = data.values(code[begin].field);
+      b.test = code[begin + 2].op;
+      b.constant = code[begin + 1].value;
+    }
+    return b;
+  }
+
+  float evaluate(const Body& b, float* sp, const RuleData& data,
+                 std::int64_t now, std::size_t period) const {
+    if (!b.column) return run(b.begin, b.end, sp, data, now, period);
+    if (b.test == Op::FIELD) return b.column[period];
+    return binary(b.test, b.column[period], b.constant);
+  }
+
+  // Aggregates the window code of `in` over its periods, using the stack
+  // above `sp`.
+  float window(const Instruction& in, float* sp, const RuleData& data,
+               std::int64_t now) const {
+    const auto [first, last] = data.window(now, in.value);
+    const Body main = body(in.a, in.b, data);
+    auto each = [&](std::size_t i) {
+      return evaluate(main, sp, data, now, i);
+    };
+    float result = in.op == Op::MAX   ? -HUGE_VALF
+                   : in.op == Op::MIN ? HUGE_VALF
+                                      : 0.0f;
+    if (in.op == Op::THEN) {
+      const Body next = body(in.c, in.d, data);
+      bool seen = false;
+      for (std::size_t i = first; i < last; i++) {
+        if (seen && truth(evaluate(next, sp, data, now, i))) return 1.0f;
+        seen = seen || truth(each(i));
+      }
+      return 0.0f;
+    }
+    for (std::size_t i = first; i < last; i++) {
+      switch (in.op) {
+        case Op::ANY:
+          if (truth(each(i))) return 1.0f;
+          break;
+        case Op::ALL:
+          if (!truth(each(i))) return 0.0f;
+          result = 1.0f;  // Only once there is a period
+          break;
+        case Op::COUNT: result += truth(each(i)) ? 1.0f : 0.0f; break;
+        case Op::MAX: result = std::max(result, each(i)); break;
+        case Op::MIN: result = std::min(result, each(i)); break;
+        default: break;
+      }
+    }
+    if ((in.op == Op::MAX || in.op == Op::MIN) && std::isinf(result))
+      return HourlyForecast::NaN;
+    return result;
+  }
+
+  // Recursive descent over one expression, emitting postfix code.
+  class Compiler {
+   public:
+    Compiler(const std::string& text, std::vector<Instruction>& code)
+        : text(text), code(code) {}
+
+    // Compiles the whole text as a rule; returns its code range.
+    std::pair<std::uint32_t, std::uint32_t> rule() {
+      std::vector<Instruction> body;
+      expression(body, false);
+      skipSpace();
+      if (pos != text.size()) fail("unexpected '" + text.substr(pos) + "'");
+      return place(body);
+    }
+
+   private:
+    const std::string& text;
+    std::vector<Instruction>& code;
+    std::size_t pos{0};
+
+    [[noreturn]] static void fail(const std::string& message) {
+      throw std::runtime_error(message);
+    }
+
+    void skipSpace() {
+      while (pos < text.size() &&
+             std::isspace(static_cast<unsigned char>(text[pos])))
+        ++pos;
+    }
+
+    bool accept(const char* symbol) {
+      skipSpace();
+      const std::size_t n = std::char_traits<char>::length(symbol);
+      if (text.compare(pos, n, symbol) != 0) return false;
+      // Words must not run on into a longer name
+      if (std::isalpha(static_cast<unsigned char>(symbol[0])) &&
+          pos + n < text.size() &&
+          (std::isalnum(static_cast<unsigned char>(text[pos + n])) ||
+           text[pos + n] == '_'))
+        return false;
+      pos += n;
+      return true;
+    }
+
+    void expect(const char* symbol) {
+      if (!accept(symbol)) fail(std::string("expected '") + symbol + "'");
+    }
+
+    std::string word() {
+      skipSpace();
+      const std::size_t start = pos;
+      while (pos < text.size() &&
+             (std::isalpha(static_cast<unsigned char>(text[pos])) ||
+              text[pos] == '_'))
+        ++pos;
+      return text.substr(start, pos - start);
+    }
+
+    // Copies finished window or rule code into the shared code vector.
+    std::pair<std::uint32_t, std::uint32_t> place(
+        const std::vector<Instruction>& body) {
+      if (depth(body) > MAX_DEPTH) fail("expression too deeply nested");
+      const auto begin = static_cast<std::uint32_t>(code.size());
+      code.insert(code.end(), body.begin(), body.end());
+      return {begin, static_cast<std::uint32_t>(code.size())};
+    }
+
+    static std::size_t depth(const std::vector<Instruction>& body) {
+      std::size_t current = 0, deepest = 0;
+      for (const auto& in : body) {
+        if (in.op == Op::CONSTANT || in.op == Op::FIELD || in.op >= Op::ANY)
+          deepest = std::max(deepest, ++current);
+        else if (in.op != Op::NEGATE && in.op != Op::NOT)
+          --current;
+      }
+      return deepest;
+    }
+
+    // `inWindow`: fields are allowed, windows are not.
+    void expression(std::vector<Instruction>& out, bool inWindow) {
+      conjunction(out, inWindow);
+      while (accept("or")) {
+        conjunction(out, inWindow);
+        out.push_back({Op::OR});
+      }
+    }
+
+    void conjunction(std::vector<Instruction>& out, bool inWindow) {
+      negation(out, inWindow);
+      while (accept("and")) {
+        negation(out, inWindow);
+        out.push_back({Op::AND});
+      }
+    }
+
+    void negation(std::vector<Instruction>& out, bool inWindow) {
+      if (accept("not")) {
+        negation(out, inWindow);
+        out.push_back({Op::NOT});
+        return;
+      }
+      comparison(out, inWindow);
+    }
+
+    void comparison(std::vector<Instruction>& out, bool inWindow) {
+      sum(out, inWindow);
+      static const std::pair<const char*, Op> OPERATORS[] = {
+          {"<=", Op::LESS_EQUAL}, {">=", Op::GREATER_EQUAL},
+          {"==", Op::EQUAL},      {"!=", Op::NOT_EQUAL},
+          {"<", Op::LESS},        {">", Op::GREATER}};
+      for (const auto& [symbol, op] : OPERATORS) {
+        if (accept(symbol)) {
+          sum(out, inWindow);
+          out.push_back({op});
+          return;
+        }
+      }
+    }
+
+    void sum(std::vector<Instruction>& out, bool inWindow) {
+      term(out, inWindow);
+      while (true) {
+        if (accept("+")) {
+          term(out, inWindow);
+          out.push_back({Op::ADD});
+        } else if (accept("-")) {
+          term(out, inWindow);
+          out.push_back({Op::SUBTRACT});
+        } else {
+          return;
+        }
+      }
+    }
+
+    void term(std::vector<Instruction>& out, bool inWindow) {
+      skipSpace();
+      if (accept("-")) {
+        term(out, inWindow);
+        out.push_back({Op::NEGATE});
+      } else if (accept("(")) {
+        expression(out, inWindow);
+        expect(")");
+      } else if (pos < text.size() &&
+                 (std::isdigit(static_cast<unsigned char>(text[pos])) ||
+                  text[pos] == '.')) {
+        out.push_back({Op::CONSTANT, RuleField{}, number()});
+      } else {
+        const std::string name = word();
+        if (name.empty()) fail("expected a value");
+        if (auto field = fieldNamed(name)) {
+          if (!inWindow)
+            fail("'" + name + "' is only known inside any(), all(), ...");
+          out.push_back({Op::FIELD, *field});
+        } else if (auto op = windowNamed(name)) {
+          if (inWindow) fail("windows can't be nested");
+          out.push_back(windowCall(*op));
+        } else {
+          fail("unknown name '" + name + "'");
+        }
+      }
+    }
+
+    // A number and its optional unit.
+    float number() {
+      const char* start = text.c_str() + pos;
+      char* end = nullptr;
+      float value = std::strtof(start, &end);
+      if (end == start) fail("expected a number");
+      pos += static_cast<std::size_t>(end - start);
+      if (accept("%")) return value;
+      const std::size_t before = pos;
+      const std::string unit = word();
+      if (unit == "d") return value * 24;
+      if (unit != "h" && unit != "mph" && unit != "F") pos = before;
+      return value;
+    }
+
+    Instruction windowCall(Op op) {
+      expect("(");
+      skipSpace();
+      Instruction in{op, RuleField{}, number()};
+      if (!(in.value > 0)) fail("window must be longer than 0 hours");
+      expect(",");
+      std::vector<Instruction> body;
+      expression(body, true);
+      std::tie(in.a, in.b) = place(body);
+      if (op == Op::THEN) {
+        expect(",");
+        body.clear();
+        expression(body, true);
+        std::tie(in.c, in.d) = place(body);
+      }
+      expect(")");
+      return in;
+    }
+
+    static std::optional<RuleField> fieldNamed(const std::string& name) {
+      if (name == "temperature") return RuleField::TEMPERATURE;
+      if (name == "dewpoint") return RuleField::DEWPOINT;
+      if (name == "wind") return RuleField::WIND;
+      if (name == "precipitation") return RuleField::PRECIPITATION;
+      if (name == "daytime") return RuleField::DAYTIME;
+      return std::nullopt;
+    }
+
+    static std::optional<Op> windowNamed(const std::string& name) {
+      if (name == "any") return Op::ANY;
+      if (name == "all") return Op::ALL;
+      if (name == "count") return Op::COUNT;
+      if (name == "max") return Op::MAX;
+      if (name == "min") return Op::MIN;
+      if (name == "then") return Op::THEN;
+      return std::nullopt;
+    }
+  };
+
+  // "name: expression", a comment or a blank line.
+  void addLine(const std::string& line) {
+    const std::size_t content = line.find_first_not_of(" \t\r");
+    if (content == std::string::npos || line[content] == '#') return;
+    const std::size_t colon = line.find(':');
+    if (colon == std::string::npos) throw std::runtime_error("expected 'name: expression'");
+    std::string name = line.substr(content, colon - content);
+    name.erase(name.find_last_not_of(" \t") + 1);
+    if (name.empty()) throw std::runtime_error("rule without a name");
+    for (const auto& rule : rules)
+      if (rule.name == name)
+        throw std::runtime_error("rule '" + name + "' defined twice");
+    std::string expression = line.substr(colon + 1);
+    if (const auto comment = expression.find('#'); comment != std::string::npos)
+      expression.erase(comment);
+    const auto [begin, end] = Compiler(expression, code).rule();
+    rules.push_back({std::move(name), begin, end});
+  }
+};
@@ -0,0 +1,528 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "WeatherModel.hpp"
+
+// The forecast of one location as it was at `observed` (seconds since the
+// epoch).
+struct ForecastSnapshot {
+  std::int64_t observed{0};
+  std::string location;
+  std::vector<ForecastPeriod> periods;
+};
+
+// The alerts active for one location at `observed`.
+struct AlertSnapshot {
+  std::int64_t observed{0};
+  std::string location;
+  std::vector<WeatherAlert> alerts;
+};
+
+// Append-only log of forecast and alert snapshots, so "how did the
+// forecast for Saturday change" or "what was active last Tuesday" can be
+// answered later. The file is a 16 byte header ("WAHS", version, reserved)
+// followed by records of
+//
+//   u32 size (whole record), u8 kind, 3 reserved bytes, i64 observed,
+//   location, u32 item count, items
+//
+// where strings are a u32 length plus bytes and all integers are little
+// endian. Records are appended with one write each; a record torn by a
+// crash is cut off the next time the file is opened. Reads go through a
+// memory mapping and a time-sorted index of the records built on open, so
+// a range query is a binary search plus a scan of just the records in
+// range. One process writes a file at a time (others open it read-only);
+// compact() drops old records by rewriting the file and renaming it over
+// the old one.
+class HistoryStore {
+ public:
+  static inline const std::uint32_t VERSION = 1;
+  static inline const std::size_t HEADER_SIZE = 16;
+  static inline const std::size_t RECORD_HEADER_SIZE = 16;
+  // How often compactIfDue() rewrites the file at most
+  static inline const std::int64_t COMPACT_INTERVAL = 3600;
+
+  enum class Kind : std::uint8_t { FORECAST = 1, ALERTS = 2 };
+
+  HistoryStore() = default;
+  explicit HistoryStore(const std::filesystem::path& path,
+                        bool readOnly = false) {
+    open(path, readOnly);
+  }
+  HistoryStore(const HistoryStore&) = delete;
+  HistoryStore& operator=(const HistoryStore&) = delete;
+  ~HistoryStore() { close(); }
+
+  // Opens `path` for appending, creating it when missing, or with
+  // `readOnly` just for queries, which leaves a file being written alone.
+  // Returns false (and stays closed) when it can't be opened or isn't a
+  // history file.
+  bool open(const std::filesystem::path& path, bool readOnly = false) {
+    close();
+    std::error_code ec;
+    if (!readOnly && (!std::filesystem::exists(path, ec) ||
+                      std::filesystem::file_size(path, ec) == 0)) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      unsigned char header[HEADER_SIZE] = {'W', 'A', 'H', 'S'};
+      writeU32(header + 4, VERSION);
+      out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+      if (!out) return false;
+    }
+    file = path;
+    file_size = static_cast<std::size_t>(std::filesystem::file_size(path, ec));
+    if (ec || !map() || length < HEADER_SIZE ||
+        std::memcmp(data, "WAHS", 4) != 0 || readU32(data + 4) != VERSION) {
+      close();
+      return false;
+    }
+    if (!buildIndex(readOnly)) {
+      close();
+      return false;
+    }
+    if (readOnly) return true;
+    writer.open(path, std::ios::binary | std::ios::app);
+    if (!writer) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    unmap();
+    if (writer.is_open()) writer.close();
+    writer.clear();
+    index.clear();
+    file.clear();
+    file_size = 0;
+  }
+
+  bool isOpen() const { return data != nullptr; }
+
+  // Number of snapshots stored.
+  std::size_t size() const { return index.size(); }
+
+  // Bytes on disk.
+  std::size_t bytes() const { return file_size; }
+
+  // Oldest and newest snapshot times; only meaningful when size() > 0.
+  std::int64_t oldest() const { return index.front().observed; }
+  std::int64_t newest() const { return index.back().observed; }
+
+  bool append(const ForecastSnapshot& snapshot) {
+    beginRecord(Kind::FORECAST, snapshot.observed, snapshot.location,
+                snapshot.periods.size());
+    for (const auto& period : snapshot.periods) {
+      putString(period.name);
+      putString(period.startTime);
+      putString(period.endTime);
+      putU8(period.isDaytime);
+      putU32(static_cast<std::uint32_t>(period.temperature));
+      putString(period.temperatureUnit);
+      putU32(static_cast<std::uint32_t>(period.precipitationChance));
+      putString(period.windSpeed);
+      putString(period.windDirection);
+      putString(period.shortForecast);
+      putString(period.detailedForecast);
+    }
+    return endRecord(Kind::FORECAST, snapshot.observed);
+  }
+
+  bool append(const AlertSnapshot& snapshot) {
+    beginRecord(Kind::ALERTS, snapshot.observed, snapshot.location,
+                snapshot.alerts.size());
+    for (const auto& alert : snapshot.alerts) {
+      putString(alert.id);
+      putString(alert.event);
+      putString(alert.headline);
+      putString(alert.description);
+      putString(alert.severity);
+      putString(alert.sent);
+      putString(alert.expires);
+      putU32(static_cast<std::uint32_t>(alert.references.size()));
+      for (const auto& reference : alert.references) putString(reference);
+    }
+    return endRecord(Kind::ALERTS, snapshot.observed);
+  }
+
+  // Forecast snapshots of `location` ("" for every location) observed in
+  // [from, to], oldest first.
+  std::vector<ForecastSnapshot> forecasts(const std::string& location,
+                                          std::int64_t from,
+                                          std::int64_t to) {
+    std::vector<ForecastSnapshot> found;
+    scan(Kind::FORECAST, location, from, to,
+         [&](Reader& r) { return readForecast(r, found); });
+    return found;
+  }
+
+  std::vector<AlertSnapshot> alerts(const std::string& location,
+                                    std::int64_t from, std::int64_t to) {
+    std::vector<AlertSnapshot> found;
+    scan(Kind::ALERTS, location, from, to,
+         [&](Reader& r) { return readAlerts(r, found); });
+    return found;
+  }
+
+  // The last alert snapshot of `location` observed at or before `when`:
+  // what was active then.
+  std::optional<AlertSnapshot> alertsAt(const std::string& location,
+                                        std::int64_t when) {
+    if (!map()) return std::nullopt;
+    auto it = std::upper_bound(
+        index.begin(), index.end(), when,
+        [](std::int64_t t, const IndexEntry& e) { return t < e.observed; });
+    while (it != index.begin()) {
+      --it;
+      if (it->kind != Kind::ALERTS) continue;
+      Reader r = reader(*it);
+      const std::string_view where = r.view();
+      if (!location.empty() && where != location) continue;
+      std::vector<AlertSnapshot> found;
+      if (!readAlerts(r, found)) return std::nullopt;
+      found.front().observed = it->observed;
+      found.front().location = std::string(where);
+      return std::move(found.front());
+    }
+    return std::nullopt;
+  }
+
+  // Rewrites the file without snapshots observed before `before`. Returns
+  // false, leaving the file as it was, if that failed.
+  bool compact(std::int64_t before) {
+    if (!writer.is_open() || !map()) return false;
+    const std::filesystem::path path = file;
+    const auto temp = path.string() + ".tmp";
+    {
+      std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(data), HEADER_SIZE);
+      auto first = std::lower_bound(
+          index.begin(), index.end(), before,
+          [](const IndexEntry& e, std::int64_t t) { return e.observed < t; });
+      for (auto it = first; it != index.end(); ++it)
+        out.write(reinterpret_cast<const char*>(data + it->offset),
+                  static_cast<std::streamsize>(readU32(data + it->offset)));
+      out.close();
+      if (!out) {
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        return false;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+      std::filesystem::remove(temp, ec);
+      return false;
+    }
+    last_compaction = before;
+    return open(path);
+  }
+
+  // Keep snapshots for `retention` (zero: forever), see compactIfDue().
+  void setRetention(std::chrono::seconds retention) {
+    retention_seconds = retention.count();
+  }
+
+  // compact()s away snapshots older than the retention once some are, at
+  // most every COMPACT_INTERVAL, so a long-running process stays bounded.
+  bool compactIfDue(std::int64_t now) {
+    if (retention_seconds <= 0 || index.empty()) return true;
+    const std::int64_t cutoff = now - retention_seconds;
+    if (index.front().observed >= cutoff ||
+        (last_compaction && cutoff < *last_compaction + COMPACT_INTERVAL))
+      return true;
+    return compact(cutoff);
+  }
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  struct IndexEntry {
+    std::int64_t observed;
+    std::size_t offset;
+    Kind kind;
+  };
+
+  // Bounds-checked decoding of one record; `ok` turns false on overrun.
+  struct Reader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok{true};
+
+    bool has(std::size_t n) {
+      if (static_cast<std::size_t>(end - p) >= n) return true;
+      ok = false;
+      p = end;
+      return false;
+    }
+    std::uint8_t u8() { return has(1) ? *p++ : 0; }
+    std::uint32_t u32() {
+      if (!has(4)) return 0;
+      const std::uint32_t v = readU32(p);
+      p += 4;
+      return v;
+    }
+    std::string_view view() {
+      const std::uint32_t n = u32();
+      if (!has(n)) return {};
+      std::string_view v(reinterpret_cast<const char*>(p), n);
+      p += n;
+      return v;
+    }
+    std::string string() { return std::string(view()); }
+    // An item count, checked against the bytes left so a corrupt record
+    // can't ask for a huge allocation.
+    std::size_t count(std::size_t minItemSize) {
+      const std::uint32_t n = u32();
+      if (n <= static_cast<std::size_t>(end - p) / minItemSize) return n;
+      ok = false;
+      p = end;
+      return 0;
+    }
+  };
+
+  std::filesystem::path file;
+  std::ofstream writer;
+  std::vector<IndexEntry> index;
+  std::string record;  // Reused encoding buffer
+  std::size_t file_size{0};
+  std::int64_t retention_seconds{0};
+  std::optional<std::int64_t> last_compaction;  // Cutoff of last compact()
+
+  const unsigned char* data{nullptr};
+  std::size_t length{0};
+  bool mapped_file{false};
+#ifdef _WIN32
+  std::vector<unsigned char> fallback;
+#endif
+
+  // Maps the whole file as written so far; appends since the last call
+  // mean mapping it again.
+  bool map() {
+    if (data && length >= file_size) return true;
+    unmap();
+    if (file.empty()) return false;
+#ifndef _WIN32
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* mapped = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                          PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        data = static_cast<const unsigned char*>(mapped);
+        length = static_cast<std::size_t>(st.st_size);
+        mapped_file = true;
+      }
+    }
+    ::close(fd);
+#else
+    // No mmap here; read the file in one go instead.
+    std::ifstream in(file, std::ios::binary);
+    if (in) {
+      fallback.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+      data = fallback.data();
+      length = fallback.size();
+    }
+#endif
+    return data != nullptr;
+  }
+
+  void unmap() {
+#ifndef _WIN32
+    if (mapped_file) munmap(const_cast<unsigned char*>(data), length);
+#else
+    fallback.clear();
+#endif
+    data = nullptr;
+    length = 0;
+    mapped_file = false;
+  }
+
+  // Walks the record headers, cutting off a torn last record unless
+  // `readOnly`.
+  bool buildIndex(bool readOnly) {
+    std::size_t offset = HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= length) {
+      const std::uint32_t size = readU32(data + offset);
+      const auto kind = static_cast<Kind>(data[offset + 4]);
+      if (size < RECORD_HEADER_SIZE || size > length - offset ||
+          (kind != Kind::FORECAST && kind != Kind::ALERTS))
+        break;
+      index.push_back({readI64(data + offset + 8), offset, kind});
+      offset += size;
+    }
+    if (offset != length && !readOnly) {
+      unmap();
+      std::error_code ec;
+      std::filesystem::resize_file(file, offset, ec);
+      if (ec) return false;
+      file_size = offset;
+      if (!map()) return false;
+    }
+    // Appended in poll order, which only a clock change breaks
+    if (!std::is_sorted(index.begin(), index.end(), earlier))
+      std::stable_sort(index.begin(), index.end(), earlier);
+    return true;
+  }
+
+  static bool earlier(const IndexEntry& a, const IndexEntry& b) {
+    return a.observed < b.observed;
+  }
+
+  Reader reader(const IndexEntry& entry) const {
+    const unsigned char* p = data + entry.offset;
+    return {p + RECORD_HEADER_SIZE, p + readU32(p)};
+  }
+
+  // Calls `decode` with the reader positioned after the location for every
+  // record of `kind` and `location` in [from, to]; it returns the snapshot
+  // it added, or nullptr, so the record's time and location get filled in.
+  template <typename Decode>
+  void scan(Kind kind, const std::string& location, std::int64_t from,
+            std::int64_t to, Decode decode) {
+    if (!map()) return;
+    auto it = std::lower_bound(
+        index.begin(), index.end(), from,
+        [](const IndexEntry& e, std::int64_t t) { return e.observed < t; });
+    for (; it != index.end() && it->observed <= to; ++it) {
+      if (it->kind != kind) continue;
+      Reader r = reader(*it);
+      const std::string_view where = r.view();
+      if (!location.empty() && where != location) continue;
+      auto* snapshot = decode(r);
+      if (!r.ok || !snapshot) continue;
+      snapshot->observed = it->observed;
+      snapshot->location = std::string(where);
+    }
+  }
+
+  static ForecastSnapshot* readForecast(Reader& r,
+                                        std::vector<ForecastSnapshot>& found) {
+    ForecastSnapshot snapshot;
+    snapshot.periods.resize(r.count(4));
+    for (auto& period : snapshot.periods) {
+      period.name = r.string();
+      period.startTime = r.string();
+      period.endTime = r.string();
+      period.isDaytime = r.u8();
+      period.temperature = static_cast<std::int32_t>(r.u32());
+      period.temperatureUnit = r.string();
+      period.precipitationChance = static_cast<std::int32_t>(r.u32());
+      period.windSpeed = r.string();
+      period.windDirection = r.string();
+      period.shortForecast = r.string();
+      period.detailedForecast = r.string();
+    }
+    if (!r.ok) return nullptr;
+    found.push_back(std::move(snapshot));
+    return &found.back();
+  }
+
+  static AlertSnapshot* readAlerts(Reader& r,
+                                   std::vector<AlertSnapshot>& found) {
+    AlertSnapshot snapshot;
+    snapshot.alerts.resize(r.count(4));
+    for (auto& alert : snapshot.alerts) {
+      alert.id = r.string();
+      alert.event = r.string();
+      alert.headline = r.string();
+      alert.description = r.string();
+      alert.severity = r.string();
+      alert.sent = r.string();
+      alert.expires = r.string();
+      alert.references.resize(r.count(4));
+      for (auto& reference : alert.references) reference = r.string();
+    }
+    if (!r.ok) return nullptr;
+    found.push_back(std::move(snapshot));
+    return &found.back();
+  }
+
+  void beginRecord(Kind kind, std::int64_t observed,
+                   const std::string& location, std::size_t items) {
+    record.assign(RECORD_HEADER_SIZE, '\0');
+    record[4] = static_cast<char>(kind);
+    unsigned char time[8];
+    writeI64(time, observed);
+    record.replace(8, 8, reinterpret_cast<const char*>(time), 8);
+    putString(location);
+    putU32(static_cast<std::uint32_t>(items));
+  }
+
+  bool endRecord(Kind kind, std::int64_t observed) {
+    if (!writer.is_open()) return false;
+    unsigned char size[4];
+    writeU32(size, static_cast<std::uint32_t>(record.size()));
+    record.replace(0, 4, reinterpret_cast<const char*>(size), 4);
+    writer.write(record.data(), static_cast<std::streamsize>(record.size()));
+    writer.flush();
+    if (!writer) return false;
+    // Normally the end of the index; earlier only after a clock change
+    const IndexEntry entry{observed, file_size, kind};
+    index.insert(std::upper_bound(index.begin(), index.end(), entry, earlier),
+                 entry);
+    file_size += record.size();
+    return true;
+  }
+
+  void putU8(std::uint8_t v) { record.push_back(static_cast<char>(v)); }
+
+  void putU32(std::uint32_t v) {
+    unsigned char bytes[4];
+    writeU32(bytes, v);
+    record.append(reinterpret_cast<const char*>(bytes), 4);
+  }
+
+  void putString(const std::string& s) {
+    putU32(static_cast<std::uint32_t>(s.size()));
+    record += s;
+  }
+
+  static std::uint32_t readU32(const unsigned char* p) {
+    return std::uint32_t{p[0]} | std::uint32_t{p[1]} << 8 |
+           std::uint32_t{p[2]} << 16 | std::uint32_t{p[3]} << 24;
+  }
+
+  static std::int64_t readI64(const unsigned char* p) {
+    return static_cast<std::int64_t>(std::uint64_t{readU32(p)} |
+                                     std::uint64_t{readU32(p + 4)} << 32);
+  }
+
+  static void writeU32(unsigned char* p, std::uint32_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+  }
+
+  static void writeI64(unsigned char* p, std::int64_t v) {
+    const auto u = static_cast<std::uint64_t>(v);
+    writeU32(p, static_cast<std::uint32_t>(u));
+    writeU32(p + 4, static_cast<std::uint32_t>(u >> 32));
+  }
+};
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <boost/json/src.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CivilTime.hpp"
+
+namespace bj = boost::json;
+
+// The NWS links a point's hourly forecast as its forecast URL plus
+// "/hourly", so cached locations don't need to store it separately.
+inline std::string hourlyForecastUrl(const std::string& forecastUrl) {
+  return forecastUrl + "/hourly";
+}
+
+// The hourly forecast (`forecastHourly`) of one location as columns: one
+// contiguous array per field, hour i at index i of each, sorted by time.
+// Threshold queries scan one column with tight branch-free loops the
+// compiler turns into SIMD code, so checking every location each cycle
+// costs next to nothing. Temperatures are in °F, wind in mph, precipitation
+// in percent and daytime 1 or 0; a value the API left out is NaN, which no
+// threshold matches.
+class HourlyForecast {
+ public:
+  static inline const float NaN = std::numeric_limits<float>::quiet_NaN();
+  static inline const float FREEZING = 32.0f;
+
+  // Index range [begin, end) of a column.
+  struct Range {
+    std::size_t begin{0};
+    std::size_t end{0};
+
+    bool empty() const { return begin >= end; }
+  };
+
+  // What the report shows about the next hours.
+  struct Outlook {
+    std::size_t hours{0};
+    float low{NaN};
+    float high{NaN};
+    float maxWind{NaN};
+    float maxPrecipitation{NaN};
+    // Start of the first hour at or below freezing
+    std::optional<std::int64_t> firstFreeze;
+  };
+
+  // Replaces every column from a forecastHourly document; throws like
+  // bj::object::at when the document isn't one.
+  void update(const bj::value& data) {
+    const bj::array& periods =
+        data.as_object().at("properties").as_object().at("periods").as_array();
+    HourlyForecast next;
+    next.reserve(periods.size());
+    for (const auto& item : periods) {
+      const bj::object& period = item.as_object();
+      auto start = parseIsoTime(period.at("startTime").as_string().c_str());
+      if (!start) continue;
+      next.time.push_back(*start);
+      next.temperature.push_back(temperatureOf(period));
+      next.dewpoint.push_back(
+          quantity(period.if_contains("dewpoint"), /*celsius=*/true));
+      next.precipitation.push_back(
+          quantity(period.if_contains("probabilityOfPrecipitation"), false));
+      next.wind.push_back(windOf(period));
+      next.daytime.push_back(daytimeOf(period));
+    }
+    // Already in order from the API, but queries rely on it
+    if (!std::is_sorted(next.time.begin(), next.time.end()))
+      next.sortByTime();
+    *this = std::move(next);
+  }
+
+  void clear() {
+    time.clear();
+    temperature.clear();
+    dewpoint.clear();
+    precipitation.clear();
+    wind.clear();
+    daytime.clear();
+  }
+
+  bool empty() const { return time.empty(); }
+
+  std::size_t size() const { return time.size(); }
+
+  // Start of each hour, seconds since the epoch.
+  const std::vector<std::int64_t>& times() const { return time; }
+  const std::vector<float>& temperatures() const { return temperature; }
+  const std::vector<float>& dewpoints() const { return dewpoint; }
+  const std::vector<float>& precipitationChances() const {
+    return precipitation;
+  }
+  // 1 for hours the API marks isDaytime, 0 for the others.
+  const std::vector<float>& daytimes() const { return daytime; }
+  const std::vector<float>& windSpeeds() const { return wind; }
+
+  // Speed in mph of an NWS windSpeed text: "10 mph", or "10 to 15 mph"
+  // (the top of the range is kept), or km/h. NaN when there is no number.
+  static float windSpeed(const char* text) {
+    float speed = NaN;
+    for (const char* p = text; *p;) {
+      if (*p >= '0' && *p <= '9') {
+        char* end = nullptr;
+        speed = std::strtof(p, &end);
+        p = end;
+      } else {
+        ++p;
+      }
+    }
+    if (std::strstr(text, "km/h")) speed *= 0.621371f;
+    return speed;
+  }
+
+  static float toFahrenheit(double celsius) {
+    return static_cast<float>(celsius * 9.0 / 5.0 + 32.0);
+  }
+
+  // Hours starting in [from, to).
+  Range window(std::int64_t from, std::int64_t to) const {
+    auto begin = std::lower_bound(time.begin(), time.end(), from);
+    auto end = std::lower_bound(begin, time.end(), to);
+    return {static_cast<std::size_t>(begin - time.begin()),
+            static_cast<std::size_t>(end - time.begin())};
+  }
+
+  // First index in `range` whose value is below `threshold`, or range.end.
+  static std::size_t firstBelow(const std::vector<float>& column, Range range,
+                                float threshold) {
+    return findFirst(column.data(), range,
+                     [threshold](float v) { return v < threshold; });
+  }
+
+  static std::size_t firstAbove(const std::vector<float>& column, Range range,
+                                float threshold) {
+    return findFirst(column.data(), range,
+                     [threshold](float v) { return v > threshold; });
+  }
+
+  // Largest value in `range`, NaN when there is none.
+  static float maxOf(const std::vector<float>& column, Range range) {
+    const float m = reduce(column.data(), range,
+                           -std::numeric_limits<float>::infinity(),
+                           [](float a, float b) { return a > b; });
+    return m == -std::numeric_limits<float>::infinity() ? NaN : m;
+  }
+
+  static float minOf(const std::vector<float>& column, Range range) {
+    const float m = reduce(column.data(), range,
+                           std::numeric_limits<float>::infinity(),
+                           [](float a, float b) { return a < b; });
+    return m == std::numeric_limits<float>::infinity() ? NaN : m;
+  }
+
+  // Summary of the `hours` hours starting at `now` (seconds since the
+  // epoch).
+  Outlook outlook(std::int64_t now, int hours) const {
+    // The hour in progress counts, so start an hour back
+    const Range range = window(now - 3600, now + hours * 3600LL);
+    Outlook result;
+    result.hours = range.end - range.begin;
+    if (range.empty()) return result;
+    result.low = minOf(temperature, range);
+    result.high = maxOf(temperature, range);
+    result.maxWind = maxOf(wind, range);
+    result.maxPrecipitation = maxOf(precipitation, range);
+    const std::size_t freeze =
+        firstBelow(temperature, range, FREEZING + 0.5f);
+    if (freeze != range.end) result.firstFreeze = time[freeze];
+    return result;
+  }
+
+ private:
+  std::vector<std::int64_t> time;
+  std::vector<float> temperature;
+  std::vector<float> dewpoint;
+  std::vector<float> precipitation;
+  std::vector<float> wind;
+  std::vector<float> daytime;
+
+  // Checks whole blocks without branching on each element, so the inner
+  // loop vectorizes; only the block that matched is searched one by one.
+  template <typename Match>
+  static std::size_t findFirst(const float* v, Range range, Match match) {
+    constexpr std::size_t BLOCK = 16;
+    std::size_t i = range.begin;
+    for (; i + BLOCK <= range.end; i += BLOCK) {
+      unsigned any = 0;
+      for (std::size_t j = 0; j < BLOCK; j++) any |= match(v[i + j]);
+      if (any) break;
+    }
+    for (; i < range.end; i++)
+      if (match(v[i])) return i;
+    return range.end;
+  }
+
+  // The value in `range` that is `better` than all others, or `identity`.
+  // Each of LANES accumulators takes every LANES-th value, so the inner
+  // loop is element-wise and vectorizes into maxps/minps, which a single
+  // running value does not without -ffast-math. The select keeps the
+  // accumulator when the comparison fails, so NaN is skipped. With fewer
+  // lanes GCC unrolls the inner loop instead and it stays scalar.
+  template <typename Better>
+  static float reduce(const float* v, Range range, float identity,
+                      Better better) {
+    constexpr std::size_t LANES = 32;
+    float lane[LANES];
+    for (std::size_t j = 0; j < LANES; j++) lane[j] = identity;
+    std::size_t i = range.begin;
+    for (; i + LANES <= range.end; i += LANES)
+      for (std::size_t j = 0; j < LANES; j++)
+        lane[j] = better(v[i + j], lane[j]) ? v[i + j] : lane[j];
+    float m = identity;
+    for (std::size_t j = 0; j < LANES; j++)
+      m = better(lane[j], m) ? lane[j] : m;
+    for (; i < range.end; i++) m = better(v[i], m) ? v[i] : m;
+    return m;
+  }
+
+  void reserve(std::size_t n) {
+    time.reserve(n);
+    temperature.reserve(n);
+    dewpoint.reserve(n);
+    precipitation.reserve(n);
+    wind.reserve(n);
+    daytime.reserve(n);
+  }
+
+  void sortByTime() {
+    std::vector<std::size_t> order(time.size());
+    for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return time[a] < time[b];
+                     });
+    auto permute = [&order](auto& column) {
+      auto copy = column;
+      for (std::size_t i = 0; i < order.size(); i++)
+        column[i] = copy[order[i]];
+    };
+    permute(time);
+    permute(temperature);
+    permute(dewpoint);
+    permute(precipitation);
+    permute(wind);
+    permute(daytime);
+  }
+
+  // `temperature` is a number with `temperatureUnit`, or (with the API's
+  // QuantitativeValue feature flag) a {unitCode, value} object.
+  static float temperatureOf(const bj::object& period) {
+    const bj::value* value = period.if_contains("temperature");
+    if (value && value->is_number()) {
+      const bj::value* unit = period.if_contains("temperatureUnit");
+      const bool celsius =
+          unit && unit->is_string() && unit->get_string() == "C";
+      const double t = value->to_number<double>();
+      return celsius ? toFahrenheit(t) : static_cast<float>(t);
+    }
+    return quantity(value, false);
+  }
+
+  // Value of a QuantitativeValue object. Temperatures are converted to °F
+  // when their unitCode says Celsius (`celsius` is the default when it
+  // doesn't say).
+  static float quantity(const bj::value* v, bool celsius) {
+    if (!v || !v->is_object()) return NaN;
+    const bj::object& q = v->get_object();
+    const bj::value* value = q.if_contains("value");
+    if (!value || !value->is_number()) return NaN;
+    const double number = value->to_number<double>();
+    if (const bj::value* unit = q.if_contains("unitCode");
+        unit && unit->is_string()) {
+      const bj::string& code = unit->get_string();
+      if (code == "wmoUnit:degC") return toFahrenheit(number);
+      if (code == "wmoUnit:degF" || code == "wmoUnit:percent")
+        return static_cast<float>(number);
+    }
+    return celsius ? toFahrenheit(number) : static_cast<float>(number);
+  }
+
+  static float daytimeOf(const bj::object& period) {
+    const bj::value* v = period.if_contains("isDaytime");
+    if (!v || !v->is_bool()) return NaN;
+    return v->get_bool() ? 1.0f : 0.0f;
+  }
+
+  static float windOf(const bj::object& period) {
+    const bj::value* v = period.if_contains("windSpeed");
+    if (!v || !v->is_string()) return NaN;
+    return windSpeed(v->get_string().c_str());
+  }
+};
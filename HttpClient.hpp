@@ -1,38 +1,425 @@
 #pragma once
 
 #include <curl/curl.h>
+
+#include <boost/json/src.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CivilTime.hpp"
+#include "HttpTransport.hpp"
+#include "ParseArena.hpp"
+#include "WeatherError.hpp"
+
+// Where the time of one request went, in seconds, and how much it
+// transferred. The connection phases are zero when an existing connection
+// was reused. With a compressed response wireBytes is what crossed the
+// network and bodyBytes what it decoded to.
+struct RequestTiming {
+  bool newConnection{false};
+  double dns{0};       // Name lookup
+  double connect{0};   // TCP handshake
+  double tls{0};       // TLS handshake
+  double wait{0};      // Request sent until the first response byte
+  double transfer{0};  // First to last response byte
+  double total{0};
+  double parse{0};     // Spent in the JSON parser while downloading
+  long long wireBytes{0};
+  long long bodyBytes{0};
+  long long headerBytes{0};
+};
+
+// Status, headers and body of one HTTP exchange. Header names are stored in
+// lower case.
+struct HttpResponse {
+  long status{0};
+  std::map<std::string, std::string> headers;
+  std::string body;
+  std::string error;  // Transfer failure; fetch() and get() throw instead
+  ErrorCause cause{ErrorCause::OTHER};  // Of `error`
+  RequestTiming timing;
+
+  // Set for JSON requests instead of body: chunks of a 2xx body are fed to
+  // `parser` as they arrive and the finished document ends up in `json`.
+  // Other bodies are dropped.
+  boost::json::stream_parser* parser{nullptr};
+  boost::json::value json;
+
+  // The raw body is kept for HttpTransport (recording, shared cache) even
+  // when streamed to `parser`
+  bool keepBody{false};
+
+  bool ok() const { return error.empty(); }
+
+  // The server confirmed our cached copy is current; body is empty.
+  bool notModified() const { return status == 304; }
+
+  std::string header(const std::string& name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? std::string() : it->second;
+  }
+};
+
+// Seconds since the epoch of an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37
+// GMT"), the only HTTP date format servers may send.
+inline std::optional<long long> parseHttpDate(const std::string& text) {
+  static const char* const MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char month[4] = {};
+  int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+  if (std::sscanf(text.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, month,
+                  &year, &hour, &minute, &second) != 6)
+    return std::nullopt;
+  const char* found = std::strstr(MONTHS, month);
+  if (!found || std::strlen(month) != 3 || (found - MONTHS) % 3)
+    return std::nullopt;
+  const int m = static_cast<int>(found - MONTHS) / 3 + 1;
+  const long long days = daysFromCivil(year, m, day);
+  return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// How long `response` stays fresh from now (RFC 9111 as a private cache):
+// max-age less Age, else Expires less Date. Zero for no-cache/no-store,
+// nullopt when the server gave no freshness information.
+inline std::optional<std::chrono::seconds> freshnessLifetime(
+    const HttpResponse& response) {
+  const std::string cacheControl = response.header("cache-control");
+  if (cacheControl.find("no-store") != std::string::npos ||
+      cacheControl.find("no-cache") != std::string::npos)
+    return std::chrono::seconds(0);
+
+  const long long age = std::atoll(response.header("age").c_str());
+  std::size_t maxAge = 0;
+  while ((maxAge = cacheControl.find("max-age", maxAge)) !=
+         std::string::npos) {
+    // Not s-maxage, which is meant for shared caches
+    const bool shared = maxAge > 0 && cacheControl[maxAge - 1] == '-';
+    maxAge += 7;
+    if (shared || maxAge >= cacheControl.size() ||
+        cacheControl[maxAge] != '=')
+      continue;
+    const long long lifetime = std::atoll(cacheControl.c_str() + maxAge + 1);
+    return std::chrono::seconds(std::max(0LL, lifetime - age));
+  }
+
+  if (auto expires = parseHttpDate(response.header("expires"))) {
+    // Both dates come from the server's clock, so skew doesn't matter
+    auto date = parseHttpDate(response.header("date"));
+    const long long now =
+        date ? *date
+             : std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+    return std::chrono::seconds(std::max(0LL, *expires - now - age));
+  }
+  return std::nullopt;
+}
 
 namespace {
   size_t writeFunction(void* ptr, size_t size, size_t nmemb, std::string* data) {
     data->append((char*)ptr, size * nmemb);
     return size * nmemb;
   }
+
+  bool successStatus(long status) { return status >= 200 && status < 300; }
+
+  size_t jsonWriteFunction(void* ptr, size_t size, size_t nmemb,
+                           HttpResponse* response) {
+    response->timing.bodyBytes += static_cast<long long>(size * nmemb);
+    // An error body (often an HTML page from a proxy or CDN) is dropped so
+    // it can't fail as bad JSON; complete() reports the status instead
+    if (!successStatus(response->status)) return size * nmemb;
+    if (response->keepBody)
+      response->body.append(static_cast<const char*>(ptr), size * nmemb);
+    const auto start = std::chrono::steady_clock::now();
+    boost::json::error_code ec;
+    response->parser->write(static_cast<const char*>(ptr), size * nmemb, ec);
+    response->timing.parse += std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+    if (ec) {
+      // Returning short makes curl abort the transfer
+      response->error = ec.message();
+      response->cause = ErrorCause::JSON_SYNTAX;
+      return 0;
+    }
+    return size * nmemb;
+  }
+
+  size_t headerFunction(char* buffer, size_t size, size_t nitems,
+                        HttpResponse* response) {
+    std::string line(buffer, size * nitems);
+    if (line.compare(0, 5, "HTTP/") == 0) {
+      // A new status line (redirect, 100-continue) starts a fresh header set
+      response->headers.clear();
+      // "HTTP/1.1 503 Service Unavailable", "HTTP/2 200"
+      const auto space = line.find(' ');
+      response->status = space == std::string::npos
+                             ? 0
+                             : std::atol(line.c_str() + space + 1);
+      return size * nitems;
+    }
+    auto colon = line.find(':');
+    if (colon != std::string::npos) {
+      std::string name = line.substr(0, colon);
+      std::transform(name.begin(), name.end(), name.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      auto begin = line.find_first_not_of(" \t", colon + 1);
+      auto end = line.find_last_not_of(" \t\r\n");
+      response->headers[name] = (begin == std::string::npos || end < begin)
+                                    ? std::string()
+                                    : line.substr(begin, end - begin + 1);
+    }
+    return size * nitems;
+  }
 }
 
+// Connection reuse bookkeeping for one HttpClient. Times are in seconds.
+struct ConnectionStats {
+  long requests{0};
+  long newConnections{0};
+  double lastHandshake{0};   // DNS + TCP + TLS cost of the last new connection
+  double handshakeTotal{0};  // Time actually spent setting up connections
+  double savedTotal{0};      // Estimated setup time avoided through reuse
+  double lastSaved{0};       // Setup time avoided by the most recent request
+};
+
 class HttpClient {
+ public:
+  // How long a response without freshness information is shared with
+  // other processes (see HttpTransport::shareCacheIn), in seconds.
+  static inline const long long SHARED_LIFETIME = 60;
+
+  // Offered in Accept-Encoding. Empty means every encoding this libcurl was
+  // built with (gzip and deflate, plus br and zstd when available); curl
+  // decodes the body as it arrives, before the write callbacks see it.
+  static inline const char* const ACCEPT_ENCODING = "";
+
  private:
   std::string curl_version;
   std::string user_agent_string; // Computed once during initialization
+  CURL* curl{nullptr};           // Long-lived handle, kept for keep-alive
+  CURLM* multi{nullptr};         // Drives fetchAll() batches
+  std::vector<CURL*> batch_pool; // Easy handles reused across batches
+  ParseArena heap_parsers{0};    // Parsers for JSON requests without an arena
+  ConnectionStats stats;
+
+  // Cache validators of the last 200 response, per URL
+  struct Validators {
+    std::string etag;
+    std::string last_modified;
+  };
+  std::unordered_map<std::string, Validators> validators;
 
   // Reference counting for instances
   static int instance_count;
 
- public:
-  HttpClient() 
-      : curl_version(get_curl_version()),
-        user_agent_string("rts C++ client with libcurl/" + curl_version) {
+  // DNS cache, TLS sessions and the connection pool are shared between
+  // every handle the process creates, including those driven by a multi
+  // handle.
+  static CURLSH* share;
+  static std::mutex share_locks[CURL_LOCK_DATA_LAST];
+
+  static void lockShare(CURL*, curl_lock_data data, curl_lock_access,
+                        void*) {
+    share_locks[data].lock();
+  }
+
+  static void unlockShare(CURL*, curl_lock_data data, void*) {
+    share_locks[data].unlock();
+  }
+
+  static void acquire() {
     if (instance_count == 0) {
       // Initialize the curl library only for the first instance
       curl_global_init(CURL_GLOBAL_DEFAULT);
+      share = curl_share_init();
+      if (share) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+      }
     }
     ++instance_count; // Increase the instance count
   }
 
+  // Stream parser for the `slot`th concurrent JSON document of a request
+  // (nullptr for text requests).
+  boost::json::stream_parser* jsonParser(bool parseJson, ParseArena* arena,
+                                         std::size_t slot) {
+    if (!parseJson) return nullptr;
+    return &(arena ? arena : &heap_parsers)->parser(slot);
+  }
+
+  HttpResponse perform(const std::string& url, bool conditional,
+                       bool parseJson, ParseArena* arena) {
+    // The handle is created once and reused so its live connection to the
+    // host can serve the next request as well.
+    if (!curl) curl = curl_easy_init();
+    if (!curl) {
+      throw WeatherError(ErrorCause::OTHER,
+                         "Failed to initialize cURL for URL: " + url);
+    }
+
+    HttpResponse response;
+    boost::json::stream_parser* parser = jsonParser(parseJson, arena, 0);
+    if (fromSharedCache(url, response, parser, conditional)) {
+      if (!response.ok()) throw WeatherError(response.cause, response.error);
+      return response;
+    }
+    configure(curl, url, &response, parser);
+    curl_slist* request_headers = conditional ? conditionalHeaders(url) : nullptr;
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request_headers);
+
+    auto ret = curl_easy_perform(curl);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_slist_free_all(request_headers);
+    if (ret != CURLE_OK)
+      fail(response, url, ret);
+    else
+      complete(curl, url, response);
+    if (!response.ok()) throw WeatherError(response.cause, response.error);
+    return response;
+  }
+
+  // Phase durations of the finished transfer on `handle`. curl reports each
+  // as the time from the start of the request to the end of that phase.
+  static void measure(CURL* handle, RequestTiming& timing) {
+    long connects = 0;
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0,
+               starttransfer = 0, total = 0, wire = 0;
+    long header = 0;
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+    // Counted before content decoding
+    curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+    curl_easy_getinfo(handle, CURLINFO_HEADER_SIZE, &header);
+
+    auto span = [](curl_off_t from, curl_off_t to) {
+      return to > from ? (to - from) / 1e6 : 0.0;
+    };
+    timing.newConnection = connects > 0;
+    timing.dns = span(0, namelookup);
+    timing.connect = span(namelookup, connect);
+    timing.tls = appconnect ? span(connect, appconnect) : 0.0;
+    timing.wait = span(pretransfer, starttransfer);
+    timing.transfer = span(starttransfer, total);
+    timing.total = span(0, total);
+    timing.wireBytes = wire;
+    timing.headerBytes = header;
+  }
+
+  // Keeps the validators of a 200 `response` for the next conditional GET.
+  void remember(const std::string& url, const HttpResponse& response) {
+    Validators v{response.header("etag"), response.header("last-modified")};
+    if (v.etag.empty() && v.last_modified.empty())
+      validators.erase(url);
+    else
+      validators[url] = v;
+  }
+
+  // Whether our validators for `url` describe the response with `headers`.
+  bool haveVersion(const std::string& url,
+                   const std::map<std::string, std::string>& headers) const {
+    auto it = validators.find(url);
+    if (it == validators.end()) return false;
+    auto header = [&](const char* name) {
+      auto found = headers.find(name);
+      return found == headers.end() ? std::string() : found->second;
+    };
+    if (!it->second.etag.empty()) return it->second.etag == header("etag");
+    return it->second.last_modified == header("last-modified");
+  }
+
+  // Marks `response` as failed by its HTTP status.
+  static void failStatus(HttpResponse& response, const std::string& url) {
+    response.error =
+        "HTTP " + std::to_string(response.status) + " for URL " + url;
+    response.cause = ErrorCause::HTTP_STATUS;
+  }
+
+  static long long epochSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Offers a 200 response to the other processes sharing the cache for as
+  // long as it is fresh; SHARED_LIFETIME when the server didn't say.
+  static void shareResponse(const std::string& url,
+                            const std::map<std::string, std::string>& headers,
+                            const std::string& body) {
+    if (!HttpTransport::sharing()) return;
+    HttpResponse meta;
+    meta.headers = headers;
+    const auto fresh = freshnessLifetime(meta);
+    const long long lifetime = fresh ? fresh->count() : SHARED_LIFETIME;
+    if (lifetime <= 0) return;  // no-cache, no-store or already stale
+    const long long now = epochSeconds();
+    HttpTransport::share(url, headers, body, now, now + lifetime);
+  }
+
+  // A 304 confirmed our copy. If the shared one is the same version it is
+  // fresh again, so siblings don't have to ask as well.
+  void renewShared(const std::string& url, const HttpResponse& response) {
+    if (!HttpTransport::sharing()) return;
+    auto entry = HttpTransport::cached(url);
+    if (!entry || !haveVersion(url, entry->headers)) return;
+    // A 304 carries the same caching headers a 200 would
+    for (const char* name : {"cache-control", "expires", "date", "age"}) {
+      auto it = response.headers.find(name);
+      if (it != response.headers.end())
+        entry->headers[name] = it->second;
+      else
+        entry->headers.erase(name);
+    }
+    shareResponse(url, entry->headers, entry->body);
+  }
+
+  void recordConnection(const RequestTiming& timing) {
+    ++stats.requests;
+    stats.lastSaved = 0;
+    if (timing.newConnection) {
+      stats.lastHandshake = timing.dns + timing.connect + timing.tls;
+      stats.handshakeTotal += stats.lastHandshake;
+      ++stats.newConnections;
+    } else {
+      stats.lastSaved = stats.lastHandshake;
+      stats.savedTotal += stats.lastSaved;
+    }
+  }
+
+ public:
+  HttpClient() 
+      : curl_version(get_curl_version()),
+        user_agent_string("rts C++ client with libcurl/" + curl_version) {
+    acquire();
+  }
+
+  // Copies get their own easy handle; the connection pool is shared anyway.
   HttpClient(const HttpClient& other)
       : curl_version(other.curl_version),
         user_agent_string(other.user_agent_string) {
-    ++instance_count; // Increase the instance count for copy constructor
+    acquire(); // Increase the instance count for copy constructor
   }
 
   HttpClient& operator=(const HttpClient& other) {
@@ -45,34 +432,280 @@ class HttpClient {
   }
 
   ~HttpClient() {
+    if (curl) curl_easy_cleanup(curl);
+    for (auto handle : batch_pool) curl_easy_cleanup(handle);
+    if (multi) curl_multi_cleanup(multi);
     --instance_count; // Decrease the instance count
     if (instance_count == 0) {
       // Cleanup the curl library only when the last instance is destroyed
+      if (share) curl_share_cleanup(share);
+      share = nullptr;
       curl_global_cleanup();
     }
   }
 
   std::string get(const std::string& url) {
-    auto curl = curl_easy_init();
-    if (!curl) {
-      throw std::runtime_error("Failed to initialize cURL for URL: " + url);
+    return perform(url, false, false, nullptr).body;
+  }
+
+  // Conditional GET: revalidates against the ETag/Last-Modified seen for
+  // this URL, so an unchanged resource comes back as an empty 304. With
+  // `parseJson` the body is parsed while it downloads (see HttpResponse),
+  // into `arena` when one is given.
+  HttpResponse fetch(const std::string& url, bool parseJson = false,
+                     ParseArena* arena = nullptr) {
+    return perform(url, true, parseJson, arena);
+  }
+
+  // Conditional GETs for all `urls` at once over a multi handle; returns
+  // when every transfer is done. Results are in the order of `urls` and a
+  // failed transfer only sets that response's error.
+  std::vector<HttpResponse> fetchAll(const std::vector<std::string>& urls,
+                                     bool parseJson = false,
+                                     ParseArena* arena = nullptr) {
+    if (!multi) multi = curl_multi_init();
+    if (!multi) throw std::runtime_error("Failed to initialize cURL multi.");
+    while (batch_pool.size() < urls.size()) {
+      CURL* handle = curl_easy_init();
+      if (!handle) throw std::runtime_error("Failed to initialize cURL.");
+      batch_pool.push_back(handle);
     }
 
-    std::string response_string;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, user_agent_string.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFunction);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
+    std::vector<HttpResponse> responses(urls.size());
+    std::vector<curl_slist*> request_headers(urls.size(), nullptr);
+    for (std::size_t i = 0; i < urls.size(); i++) {
+      boost::json::stream_parser* parser = jsonParser(parseJson, arena, i);
+      if (fromSharedCache(urls[i], responses[i], parser)) continue;
+      CURL* handle = batch_pool[i];
+      configure(handle, urls[i], &responses[i], parser);
+      request_headers[i] = conditionalHeaders(urls[i]);
+      curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request_headers[i]);
+      // Prefer waiting to multiplex over an existing HTTP/2 connection to
+      // opening a second one to the same host.
+      curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+      curl_easy_setopt(handle, CURLOPT_PRIVATE, &responses[i]);
+      curl_multi_add_handle(multi, handle);
+    }
 
-    auto ret = curl_easy_perform(curl);
-    if (ret != CURLE_OK) {
-      curl_easy_cleanup(curl); // Ensure proper cleanup
-      throw std::runtime_error("cURL error for URL " + url + ": " + curl_easy_strerror(ret));
+    int running = 0;
+    do {
+      curl_multi_perform(multi, &running);
+      if (running) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    } while (running);
+
+    int queued = 0;
+    while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      HttpResponse* response = nullptr;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &response);
+      const std::string& url = urls[response - responses.data()];
+      if (msg->data.result != CURLE_OK)
+        fail(*response, url, msg->data.result);
+      else
+        complete(msg->easy_handle, url, *response);
     }
 
-    curl_easy_cleanup(curl);
-    return response_string;
+    for (std::size_t i = 0; i < urls.size(); i++) {
+      // Handles of responses from the shared cache were never added
+      curl_multi_remove_handle(multi, batch_pool[i]);
+      curl_easy_setopt(batch_pool[i], CURLOPT_HTTPHEADER, nullptr);
+      curl_slist_free_all(request_headers[i]);
+    }
+    return responses;
+  }
+
+  // Drops the validators for `url`, e.g. when the cached copy they describe
+  // could not be used, so the next fetch() downloads the full body again.
+  void forgetValidators(const std::string& url) { validators.erase(url); }
+
+  // Answers a GET of `url` from the shared cache when some process saved a
+  // copy that is still fresh, without touching the network. If the copy is
+  // the version our validators describe it comes back (for a conditional
+  // GET) as 304, otherwise as a 200 whose body is parsed by `parser` when
+  // one is given. False when the request has to go out after all.
+  bool fromSharedCache(const std::string& url, HttpResponse& response,
+                       boost::json::stream_parser* parser,
+                       bool conditional = true) {
+    if (!HttpTransport::sharing()) return false;
+    auto entry = HttpTransport::cached(url);
+    const long long now = epochSeconds();
+    if (!entry || entry->expires <= now) return false;
+
+    response.headers = std::move(entry->headers);
+    // Its Age as any cache would report it: the server's plus our own time
+    // (RFC 9111 4.2.3), so freshness is judged as for the original
+    const long long age = std::atoll(response.header("age").c_str());
+    response.headers["age"] =
+        std::to_string(age + std::max(0LL, now - entry->stored));
+    if (conditional && haveVersion(url, response.headers)) {
+      response.status = 304;
+      return true;
+    }
+    response.status = 200;
+    response.timing.bodyBytes = static_cast<long long>(entry->body.size());
+    if (parser) {
+      boost::json::error_code ec;
+      parser->write(entry->body, ec);
+      if (!ec) parser->finish(ec);
+      if (ec) {
+        response.error = ec.message();
+        response.cause = ErrorCause::JSON_SYNTAX;
+        return true;
+      }
+      response.json = parser->release();
+    } else {
+      response.body = std::move(entry->body);
+    }
+    remember(url, response);
+    return true;
+  }
+
+  // If-None-Match/If-Modified-Since headers for `url`, or nullptr when
+  // nothing is cached. The caller frees the list with curl_slist_free_all.
+  curl_slist* conditionalHeaders(const std::string& url) const {
+    auto it = validators.find(url);
+    if (it == validators.end()) return nullptr;
+    curl_slist* list = nullptr;
+    if (!it->second.etag.empty())
+      list = curl_slist_append(list,
+                               ("If-None-Match: " + it->second.etag).c_str());
+    if (!it->second.last_modified.empty())
+      list = curl_slist_append(
+          list, ("If-Modified-Since: " + it->second.last_modified).c_str());
+    return list;
+  }
+
+  // What went wrong, in terms of ErrorCause, when a transfer ended with
+  // `code`.
+  static ErrorCause causeOf(CURLcode code) {
+    switch (code) {
+      case CURLE_COULDNT_RESOLVE_HOST:
+      case CURLE_COULDNT_RESOLVE_PROXY:
+        return ErrorCause::DNS;
+      case CURLE_COULDNT_CONNECT:
+        return ErrorCause::CONNECT;
+      case CURLE_OPERATION_TIMEDOUT:
+        return ErrorCause::TIMEOUT;
+      case CURLE_SSL_CONNECT_ERROR:
+      case CURLE_PEER_FAILED_VERIFICATION:
+      case CURLE_SSL_CERTPROBLEM:
+      case CURLE_SSL_CIPHER:
+      case CURLE_SSL_CACERT_BADFILE:
+        return ErrorCause::TLS;
+      default:
+        return ErrorCause::NETWORK;
+    }
+  }
+
+  // Marks `response` as failed by transfer error `code`, unless a write
+  // callback already recorded why it aborted the transfer. An error status
+  // that arrived before the transfer broke off is what gets reported, so
+  // its Retry-After still counts.
+  static void fail(HttpResponse& response, const std::string& url,
+                   CURLcode code) {
+    if (!response.ok()) return;
+    if (response.status >= 400) {
+      failStatus(response, url);
+      return;
+    }
+    response.error =
+        "cURL error for URL " + url + ": " + curl_easy_strerror(code);
+    response.cause = causeOf(code);
+  }
+
+  // Bookkeeping after a successful transfer on `handle`: records the status
+  // code and timings, finishes a streamed JSON body, remembers validators and
+  // updates the connection statistics. An error status or a malformed JSON
+  // body sets response.error.
+  void complete(CURL* handle, const std::string& url, HttpResponse& response) {
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status);
+    measure(handle, response.timing);
+    if (!response.parser)
+      response.timing.bodyBytes = static_cast<long long>(response.body.size());
+    if (response.parser) {
+      if (successStatus(response.status)) {
+        const auto start = std::chrono::steady_clock::now();
+        boost::json::error_code ec;
+        response.parser->finish(ec);
+        if (ec) {
+          response.error = ec.message();
+          response.cause = ErrorCause::JSON_SYNTAX;
+        } else {
+          response.json = response.parser->release();
+        }
+        response.timing.parse += std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+      }
+      response.parser = nullptr;
+    }
+    // The body of an error is the server's problem report, not the document
+    // asked for (and was dropped if it was to be parsed)
+    if (!successStatus(response.status) && !response.notModified())
+      failStatus(response, url);
+    if (response.keepBody && response.ok() && response.status == 200) {
+      HttpTransport::record(url, response.status, response.headers,
+                            response.body);
+      shareResponse(url, response.headers, response.body);
+    } else if (response.notModified()) {
+      renewShared(url, response);
+    }
+    if (response.status == 200) remember(url, response);
+    recordConnection(response.timing);
+  }
+
+  const ConnectionStats& getConnectionStats() const { return stats; }
+
+  // One line summary of connection reuse, e.g. for --timing output.
+  std::string connectionReport() const {
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss.precision(0);
+    oss << "Connections: " << stats.newConnections << " new for "
+        << stats.requests << " requests, last request saved "
+        << stats.lastSaved * 1000 << " ms, total saved "
+        << stats.savedTotal * 1000 << " ms";
+    return oss.str();
+  }
+
+  // One line breakdown of a request's time in milliseconds and its size.
+  static std::string timingReport(const RequestTiming& timing) {
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss.precision(1);
+    oss << "dns " << timing.dns * 1000 << ", connect "
+        << timing.connect * 1000 << ", tls " << timing.tls * 1000
+        << ", wait " << timing.wait * 1000 << ", transfer "
+        << timing.transfer * 1000 << ", parse " << timing.parse * 1000
+        << " ms; " << timing.bodyBytes << " bytes, " << timing.wireBytes
+        << " on the wire";
+    return oss.str();
+  }
+
+  // Applies the options shared by every request to an easy handle, so
+  // handles driven elsewhere (e.g. by a multi handle) behave like get().
+  // A `parser` switches the request to streamed JSON (see HttpResponse).
+  // The request goes wherever HttpTransport routes `url`.
+  void configure(CURL* handle, const std::string& url, HttpResponse* response,
+                 boost::json::stream_parser* parser = nullptr) const {
+    curl_easy_setopt(handle, CURLOPT_URL, HttpTransport::route(url).c_str());
+    response->keepBody =
+        HttpTransport::recording() || HttpTransport::sharing();
+    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, user_agent_string.c_str());
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, ACCEPT_ENCODING);
+    if (parser) {
+      response->parser = parser;
+      curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, jsonWriteFunction);
+      curl_easy_setopt(handle, CURLOPT_WRITEDATA, response);
+    } else {
+      curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeFunction);
+      curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response->body);
+    }
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, headerFunction);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, response);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (share) curl_easy_setopt(handle, CURLOPT_SHARE, share);
   }
 
   std::string get_curl_version(){
@@ -85,4 +718,6 @@ class HttpClient {
 
 // Initialize the instance count to 0
 int HttpClient::instance_count = 0;
+CURLSH* HttpClient::share = nullptr;
+std::mutex HttpClient::share_locks[CURL_LOCK_DATA_LAST];
 
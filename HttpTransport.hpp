@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+
+// Where HTTP requests go and whether their responses are kept, for every
+// HttpClient in the process (and every handle one of them configures):
+//
+//   redirectTo("http://127.0.0.1:8090") sends each request to that origin
+//     instead of the host in its URL, e.g. to mock-nws-server. URLs stored
+//     in settings and caches keep their real host.
+//   recordTo(dir) writes every 200 response into `dir` as a raw HTTP
+//     response, one file per path and query (see recordingName()).
+//     mock-nws-server --replay serves such a directory back.
+//   shareCacheIn(dir) keeps every 200 response in `dir`, in the same
+//     format plus when it was fetched and until when it is fresh. Every
+//     process using the directory checks it before going to the network
+//     (see HttpClient), so processes watching the same locations make one
+//     request between them instead of one each. Entries are only ever
+//     replaced by a rename, so readers take no lock and never see half an
+//     entry; two processes missing at the same time both fetch, and the
+//     last one to finish wins.
+//
+// All are meant to be set once at startup, before any request.
+class HttpTransport {
+ public:
+  static void redirectTo(std::string origin) {
+    while (!origin.empty() && origin.back() == '/') origin.pop_back();
+    redirect_origin = std::move(origin);
+  }
+
+  static void recordTo(std::filesystem::path dir) {
+    std::filesystem::create_directories(dir);
+    record_dir = std::move(dir);
+  }
+
+  static bool recording() { return !record_dir.empty(); }
+
+  static void shareCacheIn(std::filesystem::path dir) {
+    std::filesystem::create_directories(dir);
+    cache_dir = std::move(dir);
+  }
+
+  static bool sharing() { return !cache_dir.empty(); }
+
+  // A response found in the shared cache. Times are seconds since the
+  // epoch.
+  struct CachedResponse {
+    std::map<std::string, std::string> headers;
+    std::string body;
+    long long stored{0};   // When it was fetched (or last revalidated)
+    long long expires{0};  // Fresh until then
+  };
+
+  // `url` as it should actually be requested.
+  static std::string route(const std::string& url) {
+    if (redirect_origin.empty()) return url;
+    return redirect_origin + requestTarget(url);
+  }
+
+  // Path and query of `url`, e.g. "/points/44.9778,-93.265".
+  static std::string requestTarget(const std::string& url) {
+    auto scheme = url.find("://");
+    if (scheme == std::string::npos) return url;
+    auto path = url.find('/', scheme + 3);
+    return path == std::string::npos ? "/" : url.substr(path);
+  }
+
+  // File name a response to `target` is recorded under: the target with
+  // anything unusual replaced, plus a hash of the original so distinct
+  // targets never share a file.
+  static std::string recordingName(const std::string& target) {
+    std::uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    std::string name;
+    for (unsigned char c : target) {
+      hash = (hash ^ c) * 1099511628211ull;
+      bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                   (c >= '0' && c <= '9') || c == '.' || c == ',' || c == '-';
+      if (name.size() < 96) name += plain ? static_cast<char>(c) : '_';
+    }
+    char suffix[24];
+    std::snprintf(suffix, sizeof(suffix), "-%016llx.http",
+                  static_cast<unsigned long long>(hash));
+    return name + suffix;
+  }
+
+  // Saves one response. Only headers that matter for replay are kept.
+  static void record(const std::string& url, long status,
+                     const std::map<std::string, std::string>& headers,
+                     const std::string& body) {
+    if (!recording()) return;
+    write(record_dir / recordingName(requestTarget(url)), status, headers,
+          {"content-type", "etag", "last-modified", "cache-control",
+           "expires"},
+          "", body);
+  }
+
+  // Puts the 200 response to `url` into the shared cache, replacing any
+  // copy there. Date and Age are kept as well so freshness can be worked
+  // out again when it is read.
+  static void share(const std::string& url,
+                    const std::map<std::string, std::string>& headers,
+                    const std::string& body, long long stored,
+                    long long expires) {
+    if (!sharing()) return;
+    write(cache_dir / recordingName(route(url)), 200, headers,
+          {"content-type", "etag", "last-modified", "cache-control",
+           "expires", "date", "age"},
+          std::string(STORED_HEADER) + ": " + std::to_string(stored) +
+              "\r\n" + EXPIRES_HEADER + ": " + std::to_string(expires) +
+              "\r\n",
+          body);
+  }
+
+  // The shared copy of `url`, fresh or not; nullopt when there is none or
+  // it is unreadable.
+  static std::optional<CachedResponse> cached(const std::string& url) {
+    if (!sharing()) return std::nullopt;
+    std::ifstream in(cache_dir / recordingName(route(url)), std::ios::binary);
+    if (!in) return std::nullopt;
+    std::string text(std::istreambuf_iterator<char>(in), {});
+    const std::size_t end = text.find("\r\n\r\n");
+    if (text.compare(0, 13, "HTTP/1.1 200 ") != 0 ||
+        end == std::string::npos)
+      return std::nullopt;
+
+    CachedResponse response;
+    std::size_t line = text.find("\r\n") + 2;
+    while (line < end) {
+      const std::size_t next = text.find("\r\n", line);
+      const std::size_t colon = text.find(": ", line);
+      if (colon < next)
+        response.headers[text.substr(line, colon - line)] =
+            text.substr(colon + 2, next - colon - 2);
+      line = next + 2;
+    }
+    auto take = [&](const char* name) {
+      auto it = response.headers.find(name);
+      if (it == response.headers.end()) return 0LL;
+      const long long value = std::atoll(it->second.c_str());
+      response.headers.erase(it);
+      return value;
+    };
+    response.stored = take(STORED_HEADER);
+    response.expires = take(EXPIRES_HEADER);
+    response.body = text.substr(end + 4);
+    return response;
+  }
+
+ private:
+  // Our own headers in shared cache entries
+  static inline const char* const STORED_HEADER = "x-cache-stored";
+  static inline const char* const EXPIRES_HEADER = "x-cache-expires";
+
+  static inline std::string redirect_origin;
+  static inline std::filesystem::path record_dir;
+  static inline std::filesystem::path cache_dir;
+
+  // Writes a raw response with the `kept` headers plus `extra` (complete
+  // header lines) to `file`. It goes to a temporary file first and is
+  // renamed over `file`, so a concurrent reader sees the old or the new
+  // response, never half of one. The temporary name is unique per process
+  // since other processes may be writing the same entry.
+  static void write(const std::filesystem::path& file, long status,
+                    const std::map<std::string, std::string>& headers,
+                    std::initializer_list<const char*> kept,
+                    const std::string& extra, const std::string& body) {
+    static const std::string suffix =
+        "." + std::to_string(std::random_device{}()) + ".tmp";
+    const auto temp = file.string() + suffix;
+    {
+      std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+      if (!out) return;
+      out << "HTTP/1.1 " << status << " OK\r\n";
+      for (const char* name : kept) {
+        auto it = headers.find(name);
+        if (it != headers.end()) out << name << ": " << it->second << "\r\n";
+      }
+      out << extra << "\r\n" << body;
+      if (!out) {
+        out.close();
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        return;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, file, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+  }
+};
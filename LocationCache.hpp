@@ -0,0 +1,163 @@
+#pragma once
+
+#include <boost/json/src.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ParseArena.hpp"
+
+namespace fs = std::filesystem;
+namespace bj = boost::json;
+
+// Endpoints and place name a ZIP code resolved to.
+struct CachedLocation {
+  std::string forecastAPI;
+  std::string alertsAPI;
+  std::string city;
+  std::string state;
+  std::int64_t resolvedAt{};  // Unix time of the WeatherLocation lookup
+  // UGC codes national alerts are matched by (WeatherLocation::
+  // getAlertZones()); empty for entries carried over from settings.json
+  std::vector<std::string> alertZones;
+};
+
+// Persistent ZIP -> CachedLocation map so switching between (or monitoring
+// many) ZIP codes doesn't repeat the two-request WeatherLocation lookup.
+// The file is read once into a hash map; entries older than the TTL are
+// ignored and the oldest entry is evicted once the size bound is reached.
+// An empty path keeps the cache in memory only.
+class LocationCache {
+ public:
+  static inline const int DEFAULT_TTL_DAYS = 30;
+  static inline const std::size_t DEFAULT_MAX_ENTRIES = 1000;
+
+  explicit LocationCache(fs::path file, int ttlDays = DEFAULT_TTL_DAYS,
+                         std::size_t maxEntries = DEFAULT_MAX_ENTRIES)
+      : cache_file(std::move(file)),
+        ttl(std::chrono::hours(24) * ttlDays),
+        max_entries(maxEntries) {}
+
+  void load() {
+    entries.clear();
+    if (cache_file.empty() || !fs::exists(cache_file)) return;
+    std::ifstream ifile(cache_file);
+    std::stringstream buffer;
+    buffer << ifile.rdbuf();
+    try {
+      ParseArena arena(16 * 1024);
+      bj::value jv = bj::parse(buffer.str(), arena.storage());
+      for (const auto& entry : jv.as_object()) {
+        const bj::object& obj = entry.value().as_object();
+        CachedLocation location;
+        location.forecastAPI = obj.at("forecastAPI").as_string().c_str();
+        location.alertsAPI = obj.at("alertsAPI").as_string().c_str();
+        location.city = obj.at("city").as_string().c_str();
+        location.state = obj.at("state").as_string().c_str();
+        location.resolvedAt = obj.at("resolvedAt").as_int64();
+        // Written before zones were kept: look the location up again
+        const bj::value* zones = obj.if_contains("alertZones");
+        if (!zones) continue;
+        for (const auto& zone : zones->as_array())
+          location.alertZones.emplace_back(zone.as_string().c_str());
+        entries.emplace(std::string(entry.key()), std::move(location));
+      }
+    } catch (const std::exception& e) {
+      // A damaged cache only costs fresh lookups
+      std::cerr << "Ignoring " << cache_file << ": " << e.what() << '\n';
+      entries.clear();
+    }
+    dirty = false;
+  }
+
+  void save() {
+    if (!dirty || cache_file.empty()) return;
+    bj::object root;
+    for (const auto& [zip, location] : entries) {
+      bj::object obj;
+      obj["forecastAPI"] = location.forecastAPI;
+      obj["alertsAPI"] = location.alertsAPI;
+      obj["city"] = location.city;
+      obj["state"] = location.state;
+      obj["resolvedAt"] = location.resolvedAt;
+      bj::array zones;
+      for (const auto& zone : location.alertZones) zones.emplace_back(zone);
+      obj["alertZones"] = std::move(zones);
+      root[zip] = std::move(obj);
+    }
+    std::ofstream outfile(cache_file, std::ios::out);
+    if (outfile.is_open()) {
+      outfile << bj::serialize(root) << '\n';
+      dirty = false;
+    } else {
+      std::cerr << "Error opening " << cache_file << " for writing."
+                << std::endl;
+    }
+  }
+
+  // Fresh entry for `zipCode`, if any.
+  std::optional<CachedLocation> find(const std::string& zipCode) const {
+    auto it = entries.find(zipCode);
+    if (it == entries.end() || expired(it->second)) return std::nullopt;
+    return it->second;
+  }
+
+  // Adds or replaces `zipCode`; resolvedAt is set to now unless given.
+  void insert(const std::string& zipCode, CachedLocation location) {
+    if (!location.resolvedAt) location.resolvedAt = now();
+    if (!entries.count(zipCode)) {
+      evictExpired();
+      if (entries.size() >= max_entries) evictOldest();
+    }
+    entries[zipCode] = std::move(location);
+    dirty = true;
+  }
+
+  std::size_t size() const { return entries.size(); }
+
+ private:
+  fs::path cache_file;
+  std::chrono::seconds ttl;
+  std::size_t max_entries;
+  std::unordered_map<std::string, CachedLocation> entries;
+  bool dirty{false};
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  bool expired(const CachedLocation& location) const {
+    return now() - location.resolvedAt > ttl.count();
+  }
+
+  void evictExpired() {
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (expired(it->second)) {
+        it = entries.erase(it);
+        dirty = true;
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void evictOldest() {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.resolvedAt < oldest->second.resolvedAt) oldest = it;
+    }
+    if (oldest != entries.end()) {
+      entries.erase(oldest);
+      dirty = true;
+    }
+  }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+// Cumulative latency histogram with fixed buckets, the way Prometheus
+// expects them. Values are in seconds.
+class Histogram {
+ public:
+  // From a cached DNS answer to a download that nearly timed out
+  static inline const std::array<double, 15> BOUNDS{
+      0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+      0.25,   0.5,   1,      2.5,   5,    10,   30};
+
+  void observe(double value) {
+    std::size_t i = 0;
+    while (i < BOUNDS.size() && value > BOUNDS[i]) i++;
+    ++buckets[i];
+    ++count;
+    sum += value;
+  }
+
+  // Lines for series `name{labels}`, with the `le` label appended.
+  void write(std::ostream& os, const std::string& name,
+             const std::string& labels) const {
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < BOUNDS.size(); i++) {
+      cumulative += buckets[i];
+      os << name << "_bucket{" << prefix << "le=\"" << BOUNDS[i] << "\"} "
+         << cumulative << '\n';
+    }
+    os << name << "_bucket{" << prefix << "le=\"+Inf\"} " << count << '\n';
+    os << name << "_sum" << braced(labels) << ' ' << sum << '\n';
+    os << name << "_count" << braced(labels) << ' ' << count << '\n';
+  }
+
+  static std::string braced(const std::string& labels) {
+    return labels.empty() ? "" : "{" + labels + "}";
+  }
+
+ private:
+  std::array<std::uint64_t, BOUNDS.size() + 1> buckets{};  // Last is +Inf
+  std::uint64_t count{0};
+  double sum{0};
+};
+
+// Counters and histograms of one process, exported in the Prometheus text
+// format. A series is a metric name plus its labels in the form label()
+// builds; series appear on first use. Not thread safe: the polling thread
+// owns it and hands out text().
+class Metrics {
+ public:
+  // Help text for `name`, written once above its series.
+  void describe(const std::string& name, const std::string& help) {
+    families[name].help = help;
+  }
+
+  void add(const std::string& name, const std::string& labels,
+           double amount = 1) {
+    families[name].counters[labels] += amount;
+  }
+
+  void observe(const std::string& name, const std::string& labels,
+               double seconds) {
+    families[name].histograms[labels].observe(seconds);
+  }
+
+  // `name="value"`, escaped; join several with ','.
+  static std::string label(const std::string& name, const std::string& value) {
+    std::string text = name + "=\"";
+    for (char c : value) {
+      if (c == '\\' || c == '"')
+        text += '\\';
+      else if (c == '\n') {
+        text += "\\n";
+        continue;
+      }
+      text += c;
+    }
+    return text + '"';
+  }
+
+  void write(std::ostream& os) const {
+    // Enough digits that byte counters never switch to exponents
+    const auto precision = os.precision(15);
+    for (const auto& [name, family] : families) {
+      if (family.counters.empty() && family.histograms.empty()) continue;
+      if (!family.help.empty())
+        os << "# HELP " << name << ' ' << family.help << '\n';
+      os << "# TYPE " << name << ' '
+         << (family.histograms.empty() ? "counter" : "histogram") << '\n';
+      for (const auto& [labels, value] : family.counters)
+        os << name << Histogram::braced(labels) << ' ' << value << '\n';
+      for (const auto& [labels, histogram] : family.histograms)
+        histogram.write(os, name, labels);
+    }
+    os.precision(precision);
+  }
+
+  std::string text() const {
+    std::ostringstream os;
+    write(os);
+    return os.str();
+  }
+
+  // Replaces `file` with the current values, e.g. for node_exporter's
+  // textfile collector. Written to a temporary file and renamed so a
+  // scrape never sees half of it. Returns false if that failed, leaving
+  // no temporary file behind.
+  bool writeFile(const std::filesystem::path& file) const {
+    const auto temp = file.string() + ".tmp";
+    std::error_code ec;
+    {
+      std::ofstream out(temp, std::ios::trunc);
+      if (!out) return false;
+      write(out);
+      out.close();  // Flushes, so a full disk shows up here
+      if (!out) {
+        std::filesystem::remove(temp, ec);
+        return false;
+      }
+    }
+    std::filesystem::rename(temp, file, ec);
+    if (ec) {
+      std::error_code ignored;
+      std::filesystem::remove(temp, ignored);
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  struct Family {
+    std::string help;
+    std::map<std::string, double> counters;
+    std::map<std::string, Histogram> histograms;
+  };
+
+  std::map<std::string, Family> families;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+// How poll results are written: the human readable report or one JSON
+// object per line (NDJSON) for log shippers.
+enum class OutputFormat { TEXT, NDJSON };
+
+inline OutputFormat parseOutputFormat(const std::string& name) {
+  if (name == "text") return OutputFormat::TEXT;
+  if (name == "ndjson") return OutputFormat::NDJSON;
+  throw std::invalid_argument("Unknown output format \"" + name +
+                              "\" (use text or ndjson).");
+}
+
+// Everything one poll cycle writes to a stream, collected in memory and
+// handed to the stream with a single write, so the output of several
+// locations (or of stdout and stderr) never interleaves mid-record. The
+// buffer keeps its capacity between cycles.
+class OutputFrame {
+ public:
+  explicit OutputFrame(std::FILE* stream) : stream(stream), os(&buffer) {}
+
+  OutputFrame(const OutputFrame&) = delete;
+  OutputFrame& operator=(const OutputFrame&) = delete;
+
+  std::ostream& out() { return os; }
+
+  bool empty() const { return buffer.data.empty(); }
+
+  void flush() {
+    if (buffer.data.empty()) return;
+    std::fwrite(buffer.data.data(), 1, buffer.data.size(), stream);
+    std::fflush(stream);
+    buffer.data.clear();
+  }
+
+ private:
+  // streambuf appending straight to a std::string, unlike ostringstream
+  // which can't be emptied without giving up its storage.
+  struct Buffer : std::streambuf {
+    std::string data;
+
+    int overflow(int c) override {
+      if (c != traits_type::eof()) data.push_back(static_cast<char>(c));
+      return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+      data.append(s, static_cast<std::size_t>(n));
+      return n;
+    }
+  };
+
+  std::FILE* stream;
+  Buffer buffer;
+  std::ostream os;
+};
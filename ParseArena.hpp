@@ -0,0 +1,104 @@
+#pragma once
+
+#include <boost/json/src.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+
+namespace bj = boost::json;
+
+// Upstream resource that counts what it hands out, so we can tell whether
+// parsing still reaches the heap.
+class CountingResource : public bj::memory_resource {
+ public:
+  std::size_t allocations{0};
+  std::size_t bytes{0};
+
+ private:
+  void* do_allocate(std::size_t n, std::size_t align) override {
+    ++allocations;
+    bytes += n;
+    return ::operator new(n, std::align_val_t(align));
+  }
+
+  void do_deallocate(void* p, std::size_t, std::size_t align) override {
+    ::operator delete(p, std::align_val_t(align));
+  }
+
+  bool do_is_equal(const bj::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Memory for the JSON documents of one poll. Everything is carved out of a
+// reusable buffer by a bj::monotonic_resource and thrown away at once by
+// release(); when a poll outgrows the buffer it is enlarged, so steady-state
+// polling stops allocating. Documents allocated from the arena must be
+// destroyed before release() is called.
+//
+// A size of 0 disables the arena: storage() is then the default heap
+// resource. The stream parsers are reused either way.
+class ParseArena {
+ public:
+  explicit ParseArena(std::size_t size = 64 * 1024) : buffer(size) {
+    rebuild();
+  }
+
+  ParseArena(const ParseArena&) = delete;
+  ParseArena& operator=(const ParseArena&) = delete;
+
+  bj::storage_ptr storage() {
+    if (!resource) return {};
+    return bj::storage_ptr(&*resource);
+  }
+
+  // Parser number `slot`, reset so the next document it builds lives in
+  // this arena. One slot per document that is parsed concurrently.
+  bj::stream_parser& parser(std::size_t slot) {
+    while (parsers.size() <= slot)
+      parsers.push_back(std::make_unique<bj::stream_parser>());
+    parsers[slot]->reset(storage());
+    return *parsers[slot];
+  }
+
+  // Frees every document of the last poll in one go.
+  void release() {
+    if (!resource) return;
+    pollAllocations = upstream.allocations - allocationsAtRelease;
+    const std::size_t overflow = upstream.bytes - bytesAtRelease;
+    if (overflow) {
+      // Grow so the next poll of the same size fits in the buffer
+      resource.reset();
+      buffer.resize(buffer.size() + overflow);
+      rebuild();
+    } else {
+      resource->release();
+    }
+    allocationsAtRelease = upstream.allocations;
+    bytesAtRelease = upstream.bytes;
+  }
+
+  // Heap allocations made by the arena during the last released poll.
+  std::size_t lastPollAllocations() const { return pollAllocations; }
+
+  // Heap allocations made by the arena since it was created.
+  std::size_t totalAllocations() const { return upstream.allocations; }
+
+  std::size_t capacity() const { return buffer.size(); }
+
+ private:
+  std::vector<unsigned char> buffer;
+  CountingResource upstream;
+  std::optional<bj::monotonic_resource> resource;
+  std::vector<std::unique_ptr<bj::stream_parser>> parsers;
+  std::size_t allocationsAtRelease{0};
+  std::size_t bytesAtRelease{0};
+  std::size_t pollAllocations{0};
+
+  void rebuild() {
+    if (buffer.empty()) return;
+    resource.emplace(buffer.data(), buffer.size(), bj::storage_ptr(&upstream));
+  }
+};
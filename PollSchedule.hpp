@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "HttpClient.hpp"
+#include "WeatherError.hpp"
+
+// Retry-After of a 429 or 503, as delta-seconds or an HTTP date.
+inline std::optional<std::chrono::seconds> retryAfter(
+    const HttpResponse& response) {
+  if (response.status != 429 && response.status != 503) return std::nullopt;
+  const std::string value = response.header("retry-after");
+  if (value.empty()) return std::nullopt;
+  if (value.find_first_not_of("0123456789") == std::string::npos)
+    return std::chrono::seconds(std::atoll(value.c_str()));
+  auto when = parseHttpDate(value);
+  if (!when) return std::nullopt;
+  auto date = parseHttpDate(response.header("date"));
+  const long long now =
+      date ? *date
+           : std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  return std::chrono::seconds(std::max(0LL, *when - now));
+}
+
+// When one feed is polled next. After a success: the configured interval,
+// or longer while the server says its response stays fresh, plus up to 10%
+// jitter so locations and processes started together drift apart instead
+// of polling in bursts. After a failure: exponential backoff from the retry
+// delay, doubling per consecutive failure up to the normal interval, with
+// "equal jitter" (a random point in the upper half) and never earlier than
+// a Retry-After the server sent.
+class PollSchedule {
+ public:
+  using Duration = std::chrono::steady_clock::duration;
+
+  static inline const double SUCCESS_JITTER = 0.10;
+
+  Duration afterSuccess(const HttpResponse& response, Duration interval) {
+    failures = 0;
+    Duration delay = interval;
+    if (auto fresh = freshnessLifetime(response))
+      delay = std::max<Duration>(delay, *fresh);
+    return scaled(delay, 1.0 + uniform(0.0, SUCCESS_JITTER));
+  }
+
+  // `cause` decides whether backing off makes sense at all: an error
+  // status other than 429/5xx won't go away by asking again soon, so the
+  // feed goes straight to its normal interval.
+  Duration afterFailure(const HttpResponse& response, ErrorCause cause,
+                        Duration retry, Duration interval) {
+    ++failures;
+    const Duration ceiling = std::max(retry, interval);
+    Duration delay = ceiling;
+    if (!(cause == ErrorCause::HTTP_STATUS && response.status < 500 &&
+          response.status != 429)) {
+      const int doublings = std::min(failures - 1, 16);
+      delay = std::min<Duration>(ceiling, retry * (1LL << doublings));
+    }
+    delay = scaled(delay, uniform(0.5, 1.0));
+    if (auto after = retryAfter(response))
+      delay = std::max<Duration>(delay, *after);
+    return delay;
+  }
+
+  // afterSuccess() or afterFailure() for a poll that got `response`. A
+  // failed poll whose transfer went fine failed on its data, for
+  // `dataCause`.
+  Duration next(const HttpResponse& response, bool failed,
+                ErrorCause dataCause, Duration interval, Duration retry) {
+    if (!failed) return afterSuccess(response, interval);
+    return afterFailure(response, response.ok() ? dataCause : response.cause,
+                        retry, interval);
+  }
+
+  int consecutiveFailures() const { return failures; }
+
+  // Offset for the first poll of the `index`th of many locations, spreading
+  // a large start-up batch over up to a minute.
+  static Duration startupOffset(std::size_t index) {
+    return std::min<Duration>(std::chrono::milliseconds(25) * index,
+                              std::chrono::minutes(1)) +
+           std::chrono::duration_cast<Duration>(
+               std::chrono::duration<double>(uniform(0.0, 0.25)));
+  }
+
+ private:
+  int failures{0};
+
+  static double uniform(double low, double high) {
+    // Seeded per process so separate instances don't jitter alike
+    static std::mt19937 engine{std::random_device{}()};
+    return std::uniform_real_distribution<double>(low, high)(engine);
+  }
+
+  static Duration scaled(Duration d, double factor) {
+    return std::chrono::duration_cast<Duration>(d * factor);
+  }
+};
+
+// "45 seconds" or "7 minutes", for retry messages.
+inline std::string describeDelay(std::chrono::steady_clock::duration delay) {
+  const auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(delay).count();
+  if (seconds < 90) return std::to_string(seconds) + " seconds";
+  return std::to_string((seconds + 30) / 60) + " minutes";
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "SnapshotStore.hpp"
+
+// Read-only HTTP endpoint on 127.0.0.1 for the reports published to a
+// SnapshotStore, so any number of local clients can share one poller:
+//
+//   GET /            every location as text
+//   GET /json        every location as a JSON array
+//   GET /<zip>       one location as text
+//   GET /<zip>.json  one location as JSON
+//   GET /metrics     poller metrics in Prometheus text format
+//
+// One thread multiplexes all clients with poll(). Responses are copied from
+// the published snapshots, so readers never wait on (or for) the poller.
+// A client gets CLIENT_TIMEOUT_MS for its whole exchange and at most
+// MAX_CLIENTS are connected at once, so slow or idle connections can't pile
+// up; others are answered 503 and closed.
+class SnapshotServer {
+ public:
+  // Largest request head accepted; anything longer gets 400.
+  static inline const std::size_t MAX_REQUEST_BYTES = 8 * 1024;
+  // How often the thread wakes up when idle to release old snapshots and
+  // notice stop().
+  static inline const int IDLE_POLL_MS = 1000;
+  // Time from accept() to the last byte of the response. Checked every
+  // IDLE_POLL_MS at least, so a client may get up to that much longer.
+  static inline const int CLIENT_TIMEOUT_MS = 10000;
+  static inline const std::size_t MAX_CLIENTS = 256;
+
+  SnapshotServer(SnapshotStore& store, int port) : store(store), port(port) {}
+
+  SnapshotServer(const SnapshotServer&) = delete;
+  SnapshotServer& operator=(const SnapshotServer&) = delete;
+
+  ~SnapshotServer() { stop(); }
+
+  // Binds the port (throwing if that fails) and starts serving.
+  void start() {
+#ifndef _WIN32
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) throw std::runtime_error(systemError("socket"));
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<std::uint16_t>(port));
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) < 0 ||
+        ::listen(listen_fd, SOMAXCONN) < 0) {
+      std::string error = systemError("bind 127.0.0.1:" + std::to_string(port));
+      ::close(listen_fd);
+      listen_fd = -1;
+      throw std::runtime_error(error);
+    }
+    setNonBlocking(listen_fd);
+    stopping = false;
+    thread = std::thread([this] { run(); });
+#else
+    throw std::runtime_error("--serve is not supported on this platform.");
+#endif
+  }
+
+  void stop() {
+#ifndef _WIN32
+    stopping = true;
+    if (thread.joinable()) thread.join();
+    for (auto& client : clients) ::close(client.fd);
+    clients.clear();
+    if (listen_fd >= 0) ::close(listen_fd);
+    listen_fd = -1;
+#endif
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Client {
+    int fd;
+    Clock::time_point deadline;
+    std::string request;
+    std::string response;
+    std::size_t sent{0};
+  };
+
+  SnapshotStore& store;
+  int port;
+  int listen_fd{-1};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+  std::vector<Client> clients;  // Server thread only
+
+#ifndef _WIN32
+  static std::string systemError(const std::string& what) {
+    return "Server " + what + ": " + std::strerror(errno);
+  }
+
+  static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  void run() {
+    std::vector<pollfd> fds;
+    while (!stopping) {
+      // Nothing from the previous iteration is referenced any more
+      store.quiesce();
+
+      fds.clear();
+      fds.push_back({listen_fd, POLLIN, 0});
+      for (const auto& client : clients)
+        fds.push_back(
+            {client.fd, static_cast<short>(client.response.empty() ? POLLIN
+                                                                   : POLLOUT),
+             0});
+      const bool ready = ::poll(fds.data(), fds.size(), IDLE_POLL_MS) > 0;
+
+      // Walk backwards so finished clients can be swapped out in place
+      const Clock::time_point now = Clock::now();
+      for (std::size_t i = clients.size(); i-- > 0;) {
+        const bool done = ready && fds[i + 1].revents && !service(clients[i]);
+        if (done || now >= clients[i].deadline) {
+          ::close(clients[i].fd);
+          clients[i] = std::move(clients.back());
+          clients.pop_back();
+        }
+      }
+      if (ready && fds[0].revents & POLLIN) accept();
+    }
+  }
+
+  void accept() {
+    while (true) {
+      int fd = ::accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) return;
+      setNonBlocking(fd);
+      if (clients.size() >= MAX_CLIENTS) {
+        // Best effort: a fresh socket's send buffer takes the whole reply
+        static const std::string busy =
+            reply(503, "text/plain", "Too many clients\n");
+        ::send(fd, busy.data(), busy.size(), MSG_NOSIGNAL);
+        ::close(fd);
+        continue;
+      }
+      clients.push_back(Client{
+          fd, Clock::now() + std::chrono::milliseconds(CLIENT_TIMEOUT_MS), {},
+          {}, 0});
+    }
+  }
+
+  // Reads the request or writes the response; false once the client is
+  // done with (or gone).
+  bool service(Client& client) {
+    if (client.response.empty()) {
+      char buffer[2048];
+      ssize_t n = ::recv(client.fd, buffer, sizeof(buffer), 0);
+      if (n == 0) return false;
+      if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+      client.request.append(buffer, static_cast<std::size_t>(n));
+      if (client.request.find("\r\n\r\n") != std::string::npos ||
+          client.request.find("\n\n") != std::string::npos)
+        client.response = respond(client.request);
+      else if (client.request.size() > MAX_REQUEST_BYTES)
+        client.response = reply(400, "text/plain", "Bad request\n");
+      else
+        return true;
+    }
+    ssize_t n = ::send(client.fd, client.response.data() + client.sent,
+                       client.response.size() - client.sent, MSG_NOSIGNAL);
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    client.sent += static_cast<std::size_t>(n);
+    return client.sent < client.response.size();
+  }
+#endif
+
+  std::string respond(const std::string& request) {
+    const std::size_t methodEnd = request.find(' ');
+    const std::size_t pathEnd = request.find_first_of(" \r\n", methodEnd + 1);
+    if (methodEnd == std::string::npos || pathEnd == std::string::npos)
+      return reply(400, "text/plain", "Bad request\n");
+    if (request.compare(0, methodEnd, "GET") != 0)
+      return reply(405, "text/plain", "Only GET is supported\n");
+    std::string path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    if (path == "/metrics") {
+      const Snapshot* metrics = store.getMetrics();
+      return reply(200, "text/plain; version=0.0.4",
+                   metrics ? metrics->text : "");
+    }
+
+    const std::string suffix = ".json";
+    bool json = path == "/json";
+    if (path.size() > suffix.size() &&
+        path.compare(path.size() - suffix.size(), suffix.size(), suffix) ==
+            0) {
+      json = true;
+      path.erase(path.size() - suffix.size());
+    }
+    const bool all = path == "/" || path == "/json";
+    const std::string zipCode = all ? "" : path.substr(1);
+
+    std::string body = json && all ? "[" : "";
+    bool found = false;
+    for (std::size_t i = 0; i < store.size(); i++) {
+      const Snapshot* snapshot = store.get(i);
+      if (!snapshot || (!all && snapshot->zipCode != zipCode)) continue;
+      if (json && all && found) body += ',';
+      body += json ? snapshot->json : snapshot->text;
+      found = true;
+    }
+    if (json && all) body += "]";
+
+    if (!all && !found)
+      return reply(404, "text/plain", "No report for " + zipCode + "\n");
+    if (all && !found && !json) body = "No reports yet.\n";
+    return reply(200, json ? "application/json" : "text/plain; charset=utf-8",
+                 body);
+  }
+
+  static std::string reply(int status, const std::string& type,
+                           const std::string& body) {
+    const char* reason = status == 200   ? "OK"
+                         : status == 404 ? "Not Found"
+                         : status == 405 ? "Method Not Allowed"
+                         : status == 503 ? "Service Unavailable"
+                                         : "Bad Request";
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " +
+                           reason + "\r\nContent-Type: " + type +
+                           "\r\nContent-Length: " +
+                           std::to_string(body.size()) +
+                           "\r\nCache-Control: no-cache"
+                           "\r\nConnection: close\r\n\r\n";
+    response += body;
+    return response;
+  }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Rendered state of one location at the time it was published. Never
+// modified after publication, so readers can use it without copying.
+struct Snapshot {
+  std::string zipCode;
+  std::string text;  // Human readable report, as printed by the poller
+  std::string json;  // Same data as a serialized JSON object
+};
+
+// Latest Snapshot of every location, plus the latest metrics export,
+// published by the polling thread and read by one serving thread without
+// locks on either side.
+//
+// Each slot is an atomic pointer swapped by publish(). A replaced snapshot
+// is retired with the epoch of the swap and freed once the reader has
+// called quiesce() at a later epoch: the reader only holds snapshot
+// pointers between two quiesce() calls, and anything retired before its
+// last quiesce() can no longer be reached from a slot.
+class SnapshotStore {
+ public:
+  explicit SnapshotStore(std::size_t locations) : slots(locations + 1) {
+    for (auto& slot : slots) slot.store(nullptr);
+  }
+
+  SnapshotStore(const SnapshotStore&) = delete;
+  SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+  ~SnapshotStore() {
+    for (auto& slot : slots) delete slot.load();
+    for (auto& entry : retired) delete entry.snapshot;
+  }
+
+  // Number of locations.
+  std::size_t size() const { return slots.size() - 1; }
+
+  // Writer side: replaces the snapshot of `location`.
+  void publish(std::size_t location, std::unique_ptr<const Snapshot> snapshot) {
+    const Snapshot* old = slots[location].exchange(snapshot.release());
+    if (old) retired.push_back({old, epoch.fetch_add(1) + 1});
+
+    const std::uint64_t safe = reader_epoch.load();
+    std::size_t kept = 0;
+    for (auto& entry : retired) {
+      if (entry.epoch <= safe)
+        delete entry.snapshot;
+      else
+        retired[kept++] = entry;
+    }
+    retired.resize(kept);
+  }
+
+  // Writer side: replaces the metrics export (only `text` is used).
+  void publishMetrics(std::unique_ptr<const Snapshot> snapshot) {
+    publish(size(), std::move(snapshot));
+  }
+
+  // Reader side: call before each batch of get() calls; pointers from the
+  // previous batch must no longer be used.
+  void quiesce() { reader_epoch.store(epoch.load()); }
+
+  // Reader side: latest snapshot of `location`, or nullptr before the first
+  // successful poll.
+  const Snapshot* get(std::size_t location) const {
+    return slots[location].load();
+  }
+
+  // Reader side: latest metrics export, or nullptr before the first one.
+  const Snapshot* getMetrics() const { return slots.back().load(); }
+
+ private:
+  struct Retired {
+    const Snapshot* snapshot;
+    std::uint64_t epoch;
+  };
+
+  std::vector<std::atomic<const Snapshot*>> slots;
+  std::atomic<std::uint64_t> epoch{0};
+  std::atomic<std::uint64_t> reader_epoch{0};
+  std::vector<Retired> retired;  // Writer thread only
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <vector>
+
+// Min-heap of deadlines keyed by small integers (e.g. location * 2 + feed).
+// Each key has at most one live timer: scheduling a key again supersedes its
+// previous deadline, which is dropped lazily when it reaches the top. All
+// operations are O(log timers), so thousands of locations cost nothing
+// while they wait.
+class TimerQueue {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void schedule(std::size_t key, Clock::time_point due) {
+    if (generations.size() <= key) generations.resize(key + 1, 0);
+    heap.push(Entry{due, key, ++generations[key]});
+  }
+
+  void cancel(std::size_t key) {
+    if (key < generations.size()) ++generations[key];
+  }
+
+  // Removes and returns a key whose deadline is at or before `now`.
+  std::optional<std::size_t> popDue(Clock::time_point now) {
+    dropStale();
+    if (heap.empty() || heap.top().due > now) return std::nullopt;
+    std::size_t key = heap.top().key;
+    heap.pop();
+    ++generations[key];
+    return key;
+  }
+
+  // Earliest live deadline, if any timer is armed.
+  std::optional<Clock::time_point> nextDue() {
+    dropStale();
+    if (heap.empty()) return std::nullopt;
+    return heap.top().due;
+  }
+
+ private:
+  struct Entry {
+    Clock::time_point due;
+    std::size_t key;
+    std::uint64_t generation;
+
+    bool operator>(const Entry& other) const { return due > other.due; }
+  };
+
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  std::vector<std::uint64_t> generations;
+
+  void dropStale() {
+    while (!heap.empty() &&
+           heap.top().generation != generations[heap.top().key])
+      heap.pop();
+  }
+};
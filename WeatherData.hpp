@@ -4,15 +4,42 @@
 #include <boost/date_time/local_time/local_time.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/json/src.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "AlertTracker.hpp"
+#include "ForecastRules.hpp"
+#include "HourlyForecast.hpp"
+#include "WeatherModel.hpp"
 
 namespace bj = boost::json;
 
+// Forecast and alerts for one location, copied out of the NWS documents in a
+// single pass so the JSON DOM can be released right after parsing.
 class WeatherData {
  private:
-  bj::value parsed_data;
-  bj::value alert_data;
+  bool forecastLoaded{false};
+  bool alertsLoaded{false};
+  bool hourlyLoaded{false};
+  std::string generatedAt;
+  std::string updateTime;
+  std::vector<ForecastPeriod> periods;
+  std::vector<WeatherAlert> alerts;
+  HourlyForecast hourly;
+  RuleData ruleData;
   std::size_t width{80};
   static inline bool wordWrap = false;
+  // Reused across renders so wrapping stops allocating once they're big
+  // enough
+  std::string wrapped;
+  std::string scratch;
 
   boost::posix_time::ptime convertToLocalTime(const std::string& utc_time) {
     boost::posix_time::ptime time =
@@ -22,89 +49,442 @@ class WeatherData {
     return local_adj::utc_to_local(time);
   }
 
+  // Required string member; throws like bj::object::at when missing.
+  static std::string text(const bj::object& obj, const char* key) {
+    return obj.at(key).as_string().c_str();
+  }
+
+  // Optional string member; null or missing gives "".
+  static std::string optionalText(const bj::object& obj, const char* key) {
+    const bj::value* v = obj.if_contains(key);
+    return (v && v->is_string()) ? v->get_string().c_str() : "";
+  }
+
+  void writeWrapped(std::ostream& os, std::string_view text) {
+    wrapped.clear();
+    wrapText(text, width, wrapped);
+    os << wrapped;
+  }
+
+  static int optionalNumber(const bj::value* v, int fallback) {
+    if (!v || !v->is_number()) return fallback;
+    return static_cast<int>(v->to_number<double>());
+  }
+
+  // Rules look at hours when there are any, the 12-hour periods otherwise.
+  void refreshRuleData() {
+    if (hourlyLoaded)
+      ruleData.assign(hourly);
+    else
+      ruleData.assign(periods);
+  }
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // One line summarizing the hourly forecast of the next OUTLOOK_HOURS.
+  void renderOutlook(std::ostream& os) const {
+    const HourlyForecast::Outlook o = hourly.outlook(now(), OUTLOOK_HOURS);
+    if (!o.hours) return;
+    os << "Next " << OUTLOOK_HOURS << " hours: ";
+    if (!std::isnan(o.low))
+      os << std::lround(o.low) << " to " << std::lround(o.high) << " F";
+    if (o.firstFreeze) {
+      std::time_t when = static_cast<std::time_t>(*o.firstFreeze);
+      char buffer[32];
+      std::strftime(buffer, sizeof(buffer), "%a %H:%M",
+                    std::localtime(&when));
+      os << ", freezing from " << buffer;
+    }
+    if (!std::isnan(o.maxWind))
+      os << ", wind up to " << std::lround(o.maxWind) << " mph";
+    if (!std::isnan(o.maxPrecipitation))
+      os << ", precipitation up to " << std::lround(o.maxPrecipitation)
+         << "%";
+    os << "\n\n";
+  }
+
  public:
+  // Span of the hourly outlook in reports.
+  static inline const int OUTLOOK_HOURS = 48;
+
+  // Starts without any feed; fill it with updateForecast/updateAlerts.
+  explicit WeatherData(const bool wrap) { wordWrap = wrap; }
+
   WeatherData(const std::string& raw_data, const std::string& raw_alert,
               const bool wrap) {
-    parsed_data = bj::parse(raw_data);
-    alert_data = bj::parse(raw_alert);
+    updateForecast(raw_data);
+    updateAlerts(raw_alert);
     wordWrap = wrap;
   }
-  std::string textWrap(std::string input) {
-    std::istringstream in{input};
-    std::ostringstream out;
-    std::string word, line, inputLine;
 
-    while (std::getline(in, inputLine)) {
-      std::istringstream lineStream(inputLine);
+  // Replace one feed while keeping the other, e.g. when only one of them
+  // changed upstream.
+  void updateForecast(const std::string& raw_data) {
+    updateForecast(bj::parse(raw_data));
+  }
+
+  void updateAlerts(const std::string& raw_alert) {
+    updateAlerts(bj::parse(raw_alert));
+  }
+
+  // Already parsed documents, e.g. streamed by HttpClient. Only the fields
+  // that are rendered are kept; `data` is released on return.
+  void updateForecast(bj::value data) {
+    const bj::object& properties =
+        data.as_object().at("properties").as_object();
+    std::string generated = text(properties, "generatedAt");
+    std::string updated = text(properties, "updateTime");
+
+    const bj::array& source = properties.at("periods").as_array();
+    std::vector<ForecastPeriod> extracted;
+    extracted.reserve(source.size());
+    for (const auto& item : source) {
+      const bj::object& period = item.as_object();
+      ForecastPeriod p;
+      p.name = text(period, "name");
+      p.startTime = optionalText(period, "startTime");
+      p.endTime = optionalText(period, "endTime");
+      if (auto day = period.if_contains("isDaytime"); day && day->is_bool())
+        p.isDaytime = day->get_bool();
+      p.temperature = optionalNumber(period.if_contains("temperature"), 0);
+      p.temperatureUnit = optionalText(period, "temperatureUnit");
+      if (auto pop = period.if_contains("probabilityOfPrecipitation");
+          pop && pop->is_object())
+        p.precipitationChance =
+            optionalNumber(pop->get_object().if_contains("value"), -1);
+      p.windSpeed = optionalText(period, "windSpeed");
+      p.windDirection = optionalText(period, "windDirection");
+      p.shortForecast = optionalText(period, "shortForecast");
+      p.detailedForecast = text(period, "detailedForecast");
+      extracted.push_back(std::move(p));
+    }
+
+    generatedAt = std::move(generated);
+    updateTime = std::move(updated);
+    periods = std::move(extracted);
+    forecastLoaded = true;
+    if (!hourlyLoaded) refreshRuleData();
+  }
+
+  void updateAlerts(bj::value data) {
+    const bj::array& features = data.as_object().at("features").as_array();
+    std::vector<WeatherAlert> extracted;
+    extracted.reserve(features.size());
+    for (const auto& feature : features)
+      extracted.push_back(
+          extractAlert(feature.as_object().at("properties").as_object()));
+    setAlerts(std::move(extracted));
+  }
+
+  // Alerts already extracted elsewhere, e.g. from the national feed.
+  void setAlerts(std::vector<WeatherAlert> extracted) {
+    alerts = std::move(extracted);
+    alertsLoaded = true;
+  }
+
+  // The fields kept of one alert feature's `properties`.
+  static WeatherAlert extractAlert(const bj::object& properties) {
+    WeatherAlert a;
+    a.id = optionalText(properties, "id");
+    a.event = text(properties, "event");
+    a.headline = optionalText(properties, "headline");
+    a.description = optionalText(properties, "description");
+    a.severity = optionalText(properties, "severity");
+    a.sent = optionalText(properties, "sent");
+    a.expires = optionalText(properties, "expires");
+    if (auto refs = properties.if_contains("references");
+        refs && refs->is_array()) {
+      for (const auto& ref : refs->get_array()) {
+        if (!ref.is_object()) continue;
+        std::string refId = optionalText(ref.get_object(), "identifier");
+        if (!refId.empty()) a.references.push_back(std::move(refId));
+      }
+    }
+    return a;
+  }
+
+  // The forecastHourly document, kept as columns (see HourlyForecast).
+  void updateHourly(bj::value data) {
+    hourly.update(data);
+    hourlyLoaded = true;
+    refreshRuleData();
+  }
+
+  // Forget a feed that could not be refreshed so stale data isn't shown.
+  void clearForecast() {
+    forecastLoaded = false;
+    periods.clear();
+    if (!hourlyLoaded) refreshRuleData();
+  }
+
+  void clearAlerts() {
+    alertsLoaded = false;
+    alerts.clear();
+  }
+
+  void clearHourly() {
+    hourlyLoaded = false;
+    hourly.clear();
+    refreshRuleData();
+  }
+
+  bool hasForecast() const { return forecastLoaded; }
+
+  bool hasAlerts() const { return alertsLoaded; }
+
+  bool hasHourly() const { return hourlyLoaded; }
+
+  void renderAlerts(std::ostream& os, const AlertChanges* changes) {
+    if (changes)
+      printAlertChanges(*changes, os);
+    else
+      printAlerts(os);
+  }
+
+  const std::vector<ForecastPeriod>& getPeriods() const { return periods; }
+
+  const std::vector<WeatherAlert>& getAlerts() const { return alerts; }
+
+  const HourlyForecast& getHourly() const { return hourly; }
+
+  // The forecast as RuleSet evaluates it.
+  const RuleData& getRuleData() const { return ruleData; }
+
+  // The extracted fields as one JSON object, times left in ISO 8601 as the
+  // API sent them. A missing feed is null.
+  bj::object toJson() const {
+    bj::object root;
+    root["generatedAt"] = generatedAt;
+    root["updateTime"] = updateTime;
+    if (forecastLoaded) {
+      bj::array list;
+      list.reserve(periods.size());
+      for (const auto& p : periods) {
+        bj::object period;
+        period["name"] = p.name;
+        period["startTime"] = p.startTime;
+        period["endTime"] = p.endTime;
+        period["isDaytime"] = p.isDaytime;
+        period["temperature"] = p.temperature;
+        period["temperatureUnit"] = p.temperatureUnit;
+        if (p.precipitationChance >= 0)
+          period["precipitationChance"] = p.precipitationChance;
+        period["windSpeed"] = p.windSpeed;
+        period["windDirection"] = p.windDirection;
+        period["shortForecast"] = p.shortForecast;
+        period["detailedForecast"] = p.detailedForecast;
+        list.push_back(std::move(period));
+      }
+      root["periods"] = std::move(list);
+    } else {
+      root["periods"] = nullptr;
+    }
+    if (alertsLoaded) {
+      bj::array list;
+      list.reserve(alerts.size());
+      for (const auto& a : alerts) {
+        bj::object alert;
+        alert["id"] = a.id;
+        alert["event"] = a.event;
+        alert["headline"] = a.headline;
+        alert["description"] = a.description;
+        alert["severity"] = a.severity;
+        alert["sent"] = a.sent;
+        alert["expires"] = a.expires;
+        list.push_back(std::move(alert));
+      }
+      root["alerts"] = std::move(list);
+    } else {
+      root["alerts"] = nullptr;
+    }
+    if (hourlyLoaded) {
+      const HourlyForecast::Outlook o = hourly.outlook(now(), OUTLOOK_HOURS);
+      auto number = [](float v) -> bj::value {
+        if (std::isnan(v)) return nullptr;
+        return static_cast<double>(v);
+      };
+      bj::object outlook;
+      outlook["hours"] = o.hours;
+      outlook["low"] = number(o.low);
+      outlook["high"] = number(o.high);
+      outlook["maxWind"] = number(o.maxWind);
+      outlook["maxPrecipitation"] = number(o.maxPrecipitation);
+      if (o.firstFreeze) {
+        std::time_t when = static_cast<std::time_t>(*o.firstFreeze);
+        char buffer[32];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ",
+                      std::gmtime(&when));
+        outlook["firstFreeze"] = buffer;
+      } else
+        outlook["firstFreeze"] = nullptr;
+      root["outlook"] = std::move(outlook);
+    }
+    return root;
+  }
 
-      while (lineStream >> word) {
-        if (line.size() + 1 + word.size() >= width) {
-          out << line << '\n';
-          line = word;
+  // Appends `input` to `out` word-wrapped to lines shorter than `width`
+  // columns. Line breaks in the input are kept and each input line is
+  // wrapped on its own; a run of blank lines (an NWS paragraph break)
+  // becomes exactly one blank line. Columns are counted in UTF-8 code
+  // points so multibyte characters don't shorten the line. Single pass,
+  // no allocation beyond growing `out`.
+  static void wrapText(std::string_view input, std::size_t width,
+                       std::string& out) {
+    auto isSpace = [](char c) {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    };
+    std::size_t column = 0;
+    bool wroteLine = false;     // Something was output before
+    bool paragraphBreak = false;  // Blank input line(s) since then
+    std::size_t pos = 0;
+    while (pos < input.size()) {
+      std::size_t eol = input.find('\n', pos);
+      if (eol == std::string_view::npos) eol = input.size();
+      bool lineStarted = false;
+      std::size_t i = pos;
+      while (true) {
+        while (i < eol && isSpace(input[i])) ++i;
+        if (i == eol) break;
+        const std::size_t start = i;
+        std::size_t wordColumns = 0;
+        for (; i < eol && !isSpace(input[i]); ++i) {
+          // Count every byte except UTF-8 continuation bytes
+          if ((static_cast<unsigned char>(input[i]) & 0xC0) != 0x80)
+            ++wordColumns;
+        }
+        const std::string_view word = input.substr(start, i - start);
+        if (!lineStarted) {
+          if (paragraphBreak && wroteLine) out += '\n';
+          paragraphBreak = false;
+          lineStarted = true;
+          column = wordColumns;
+        } else if (column + 1 + wordColumns >= width) {
+          out += '\n';
+          column = wordColumns;
         } else {
-          if (!line.empty()) line += ' ';
-          line += word;
+          out += ' ';
+          column += 1 + wordColumns;
         }
+        out.append(word);
       }
-
-      if (!line.empty()) {
-        out << line << '\n';
-        line.clear();
+      if (lineStarted) {
+        out += '\n';
+        wroteLine = true;
+      } else {
+        paragraphBreak = true;
       }
+      pos = eol + 1;
+    }
+  }
+
+  std::string textWrap(std::string_view input) {
+    std::string out;
+    out.reserve(input.size() + input.size() / width + 1);
+    wrapText(input, width, out);
+    return out;
+  }
+
+  // Appends one period ("Name: forecast") to `out`, wrapped if enabled.
+  void appendForecastForPeriod(int period, std::string& out) {
+    const ForecastPeriod& forecast = periods.at(period);
+    if (wordWrap) {
+      scratch.assign(forecast.name).append(": ").append(
+          forecast.detailedForecast);
+      wrapText(scratch, width, out);
+    } else {
+      out.append(forecast.name)
+          .append(": ")
+          .append(forecast.detailedForecast)
+          .append("\n");
     }
-    return out.str();
   }
 
   std::string getForecastForPeriod(int period) {
-    bj::object properties =
-        parsed_data.as_object().at("properties").as_object();
-    bj::object forecast =
-        properties.at("periods").as_array().at(period).as_object();
-    std::string output{
-        std::string(forecast.at("name").as_string().c_str()) + ": " +
-        std::string(forecast.at("detailedForecast").as_string().c_str())};
-    if (wordWrap)
-      return textWrap(output);
-    else
-      return output + "\n";
+    std::string output;
+    appendForecastForPeriod(period, output);
+    return output;
   }
 
   std::string getUpdateTime() {
-    bj::object properties =
-        parsed_data.as_object().at("properties").as_object();
-    return "Updated: \t" +
-           std::string(boost::posix_time::to_simple_string(convertToLocalTime(
-               properties.at("updateTime").as_string().c_str())));
+    return "Updated: \t" + std::string(boost::posix_time::to_simple_string(
+                               convertToLocalTime(updateTime)));
   }
 
   std::string getGeneratedTime() {
-    bj::object properties =
-        parsed_data.as_object().at("properties").as_object();
-    return "Generated: \t" +
-           std::string(boost::posix_time::to_simple_string(convertToLocalTime(
-               properties.at("generatedAt").as_string().c_str())));
-  }
-
-  void printAlerts() {
-    bj::array features = alert_data.as_object().at("features").as_array();
-    for (auto& alert : features) {
-      std::cout << "*** ";
-      std::cout
-          << alert.at("properties").as_object().at("event").as_string().c_str();
-      std::cout << " ***\n";
-      std::cout << textWrap(alert.at("properties")
-                                .as_object()
-                                .at("headline")
-                                .as_string()
-                                .c_str());
-      std::cout << "\n";
-      std::cout << textWrap(alert.at("properties")
-                                .as_object()
-                                .at("description")
-                                .as_string()
-                                .c_str());
-      std::cout << "\n";
+    return "Generated: \t" + std::string(boost::posix_time::to_simple_string(
+                                 convertToLocalTime(generatedAt)));
+  }
+
+  void printAlerts(std::ostream& os = std::cout) {
+    for (const auto& alert : alerts) {
+      os << "*** " << alert.event << " ***\n";
+      writeWrapped(os, alert.headline);
+      os << "\n";
+      writeWrapped(os, alert.description);
+      os << "\n";
+    }
+    if (alerts.size()) os << "\n";
+  }
+
+  // Only what changed since the previous cycle; unchanged alerts are
+  // summarized in one line.
+  void printAlertChanges(const AlertChanges& changes,
+                         std::ostream& os = std::cout) {
+    for (const auto* alert : changes.added) {
+      os << "*** " << alert->event << " ***\n";
+      writeWrapped(os, alert->headline);
+      os << "\n";
+      writeWrapped(os, alert->description);
+      os << "\n";
+    }
+    for (const auto* alert : changes.updated) {
+      os << "*** Updated: " << alert->event << " ***\n";
+      writeWrapped(os, alert->headline);
+      os << "\n";
+      writeWrapped(os, alert->description);
+      os << "\n";
+    }
+    for (const auto& alert : changes.expired) {
+      os << "*** Expired: " << alert.event << " ***\n";
+      writeWrapped(os, alert.headline);
+      os << "\n";
+    }
+    if (changes.unchanged)
+      os << changes.unchanged << " active alert"
+         << (changes.unchanged == 1 ? "" : "s") << " unchanged.\n";
+    if (!changes.empty() || changes.unchanged) os << "\n";
+  }
+
+  // Writes one full report: timestamps, alerts, the hourly outlook when
+  // the hourly forecast is loaded and the next `numPeriods` forecast
+  // periods. With `changes` only new, updated and expired alerts are
+  // written instead of every active one. Either feed may be missing; the
+  // other one is still shown.
+  void render(std::ostream& os, int numPeriods,
+              const AlertChanges* changes = nullptr) {
+    if (!hasForecast()) {
+      if (hasAlerts()) renderAlerts(os, changes);
+      os << "Forecast unavailable.\n";
+      return;
+    }
+    os << getGeneratedTime() << "\n";
+    os << getUpdateTime() << "\n\n";
+    if (hasAlerts())
+      renderAlerts(os, changes);
+    else
+      os << "Alerts unavailable.\n\n";
+    if (hasHourly()) renderOutlook(os);
+    // -p may ask for more periods than the forecast has
+    const int shown = std::min(numPeriods, static_cast<int>(periods.size()));
+    for (int i = 0; i < shown; i++) {
+      wrapped.clear();
+      appendForecastForPeriod(i, wrapped);
+      os << wrapped;
+      if (i != shown - 1) os << "\n";
     }
-    if (features.size()) std::cout << "\n";
   }
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Why a poll failed, for counting and for choosing what to tell the user.
+enum class ErrorCause {
+  DNS,          // Host name could not be resolved
+  CONNECT,      // TCP connection refused or unreachable
+  TLS,          // Handshake or certificate failure
+  TIMEOUT,      // Transfer took longer than allowed
+  NETWORK,      // Any other transfer failure
+  HTTP_STATUS,  // The server answered with an error status
+  JSON_SYNTAX,  // Body is not valid JSON
+  BAD_DATA,     // Valid JSON, but not the document expected
+  OTHER
+};
+
+// Label used for `cause` in the metrics export.
+inline const char* causeName(ErrorCause cause) {
+  switch (cause) {
+    case ErrorCause::DNS: return "dns";
+    case ErrorCause::CONNECT: return "connect";
+    case ErrorCause::TLS: return "tls";
+    case ErrorCause::TIMEOUT: return "timeout";
+    case ErrorCause::NETWORK: return "network";
+    case ErrorCause::HTTP_STATUS: return "http_status";
+    case ErrorCause::JSON_SYNTAX: return "json_syntax";
+    case ErrorCause::BAD_DATA: return "bad_data";
+    case ErrorCause::OTHER: break;
+  }
+  return "other";
+}
+
+// A failed fetch or a document that could not be used, with its cause.
+class WeatherError : public std::runtime_error {
+ public:
+  WeatherError(ErrorCause cause, const std::string& what)
+      : std::runtime_error(what), cause_(cause) {}
+
+  ErrorCause cause() const { return cause_; }
+
+ private:
+  ErrorCause cause_;
+};
+
+inline ErrorCause classifyError(const std::exception& e) {
+  if (auto* error = dynamic_cast<const WeatherError*>(&e))
+    return error->cause();
+  return ErrorCause::OTHER;
+}
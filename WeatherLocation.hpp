@@ -3,25 +3,39 @@
 #include <boost/json/src.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
+#include <algorithm>
 #include <iostream>
-#include <regex>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace bj = boost::json;
 
 #include "HttpClient.hpp"
+#include "ParseArena.hpp"
+#include "ZipGazetteer.hpp"
 
 class WeatherLocation {
  public:
-  WeatherLocation(std::string zipCode) : zipCode(zipCode) {
-    std::regex zipCodeTest("^\\d{5,5}$");
-    if (!std::regex_search(zipCode, zipCodeTest)) {
+  // The offline `gazetteer` is tried first; the graphical.weather.gov
+  // lookup is only used for ZIP codes it doesn't know.
+  WeatherLocation(std::string zipCode,
+                  const ZipGazetteer* gazetteer = nullptr)
+      : zipCode(zipCode) {
+    if (!isValidZipCode(zipCode)) {
       throw std::runtime_error("Invalid ZIP code!\n");
     }
     std::cout << "Getting Lat/Long from ZIP code. . . ";
-    std::string zipXML = httpClient.get(zipXMLUrl + zipCode);
-    latLong = getLatLong(zipXML);
-    if (latLong == ",") throw std::string("Invalid ZIP code!");
+    std::optional<std::string> offline;
+    if (gazetteer) offline = gazetteer->latLong(zipCode);
+    if (offline) {
+      latLong = *offline;
+    } else {
+      std::string zipXML = httpClient.get(zipXMLUrl + zipCode);
+      latLong = getLatLong(zipXML);
+      if (latLong == ",") throw std::string("Invalid ZIP code!");
+    }
     std::cout << latLong << '\n';
     std::cout << "Getting grid data from Weather.gov. . .\n";
     std::string gridJSON = httpClient.get(grid_api_base + latLong);
@@ -40,6 +54,11 @@ class WeatherLocation {
 
   std::string getAlertsAPI() { return alerts_api; }
 
+  // UGC codes of the county, forecast zone and fire weather zone, the
+  // codes national alerts are keyed by. Some products (heat, winter, fire
+  // weather) name only the zones.
+  std::vector<std::string> getAlertZones() { return alert_zones; }
+
   void setCity(std::string theCity) { city = theCity; }
 
   void setState(std::string theState) { state = theState; }
@@ -67,8 +86,11 @@ class WeatherLocation {
   }
 
   void parseJson(std::string gridJSON) {
-    bj::value data = bj::parse(gridJSON);
-    bj::object obj = data.as_object();
+    // The grid document is only read here; parse it into a scratch arena
+    // instead of allocating every node individually.
+    ParseArena arena(16 * 1024);
+    bj::value data = bj::parse(gridJSON, arena.storage());
+    const bj::object& obj = data.as_object();
     city = obj.at("properties")
                .as_object()
                .at("relativeLocation")
@@ -94,6 +116,17 @@ class WeatherLocation {
     std::string alertsZone = alerts_string.substr(
         alerts_string.find_last_of("/") + 1, alerts_string.length());
     alerts_api = alerts_api_base + alertsZone;
+    alert_zones = {alertsZone};
+    for (const char* key : {"forecastZone", "fireWeatherZone"}) {
+      const bj::value* url = obj.at("properties").as_object().if_contains(key);
+      if (!url || !url->is_string()) continue;
+      const std::string zone_string = url->get_string().c_str();
+      const std::string zone =
+          zone_string.substr(zone_string.find_last_of("/") + 1);
+      if (!zone.empty() && std::find(alert_zones.begin(), alert_zones.end(),
+                                     zone) == alert_zones.end())
+        alert_zones.push_back(zone);
+    }
   }
 
   HttpClient httpClient;
@@ -103,6 +136,7 @@ class WeatherLocation {
   std::string zipCode;
   std::string alerts_api_base = "https://api.weather.gov/alerts/active/zone/";
   std::string alerts_api;
+  std::vector<std::string> alert_zones;
   std::string grid_api_base = "https://api.weather.gov/points/";
   std::string grid_api;
   std::string forecast_api;
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One period of the 12-hour text forecast.
+struct ForecastPeriod {
+  std::string name;
+  std::string startTime;
+  std::string endTime;
+  bool isDaytime{false};
+  int temperature{0};
+  std::string temperatureUnit;
+  int precipitationChance{-1};  // Percent, -1 when not given
+  std::string windSpeed;
+  std::string windDirection;
+  std::string shortForecast;
+  std::string detailedForecast;
+};
+
+// One active NWS alert.
+struct WeatherAlert {
+  std::string id;
+  std::string event;
+  std::string headline;
+  std::string description;
+  std::string severity;
+  std::string sent;
+  std::string expires;
+  std::vector<std::string> references;  // ids of alerts this one replaces
+};
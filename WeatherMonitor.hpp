@@ -0,0 +1,996 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AlertIndex.hpp"
+#include "AlertTracker.hpp"
+#include "HistoryStore.hpp"
+#include "HttpClient.hpp"
+#include "Metrics.hpp"
+#include "OutputFrame.hpp"
+#include "ParseArena.hpp"
+#include "PollSchedule.hpp"
+#include "SnapshotStore.hpp"
+#include "TimerQueue.hpp"
+#include "WeatherData.hpp"
+#include "WeatherError.hpp"
+#include "WeatherSettings.hpp"
+
+inline std::string getCurrentTimeStamp() {
+  // Get the current time point
+  auto now = std::chrono::system_clock::now();
+  // Convert to a time_t
+  std::time_t current_time = std::chrono::system_clock::to_time_t(now);
+  // Convert to local time
+  std::tm* local_tm = std::localtime(&current_time);
+  char timeBuffer[32];
+  std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%b-%d %H:%M:%S", local_tm);
+
+  return static_cast<std::string>(timeBuffer);
+}
+
+// Current UTC time in ISO 8601, for machine readable output.
+inline std::string getIsoTimeStamp() {
+  std::time_t now = std::chrono::system_clock::to_time_t(
+      std::chrono::system_clock::now());
+  char timeBuffer[32];
+  std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%dT%H:%M:%SZ",
+                std::gmtime(&now));
+  return timeBuffer;
+}
+
+// Turns the exceptions thrown while fetching/parsing a forecast into the
+// message shown to the user.
+inline std::string describeWeatherError(const std::exception& e) {
+  switch (classifyError(e)) {
+    case ErrorCause::HTTP_STATUS:
+      return "weather.gov API unavailable. ";
+    case ErrorCause::JSON_SYNTAX:
+      return "Bad JSON data. weather.gov API down. This is unusual. ";
+    case ErrorCause::BAD_DATA:
+      return "Unexpected data from weather.gov: " + std::string(e.what()) +
+             "\n";
+    default:
+      return "Error: " + std::string(e.what()) + "\n";
+  }
+}
+
+// The parsed document of a 200 response: streamed responses already hold
+// it, others are parsed from the body here.
+inline bj::value feedDocument(HttpResponse& response) {
+  if (!response.json.is_null()) return std::move(response.json);
+  bj::error_code ec;
+  bj::value document = bj::parse(response.body, ec);
+  if (ec) throw WeatherError(ErrorCause::JSON_SYNTAX, ec.message());
+  return document;
+}
+
+// Runs `update`, reporting anything it throws about the shape of the
+// document as bad data.
+template <typename Update>
+void extractFeed(Update&& update) {
+  try {
+    update();
+  } catch (const WeatherError&) {
+    throw;
+  } catch (const std::exception& e) {
+    throw WeatherError(ErrorCause::BAD_DATA, e.what());
+  }
+}
+
+// Brings `weatherData` up to date with the responses of one poll; a feed
+// that was not polled (or, for `hourly`, isn't used) is nullptr and keeps
+// its data. Feeds answered with 304
+// Not Modified keep their previously parsed data instead of being
+// downloaded and parsed again. A feed whose transfer failed is cleared so
+// the other one can still be shown and is returned (nullptr when every
+// polled feed was refreshed). Unusable documents throw WeatherError.
+// `zoneAlerts` are the alerts `alerts` brought when they were already
+// extracted from the national feed (see AlertIndex).
+inline const HttpResponse* updateWeatherData(
+    std::optional<WeatherData>& weatherData, HttpResponse* forecast,
+    HttpResponse* alerts, bool wordWrap, HttpResponse* hourly = nullptr,
+    std::vector<WeatherAlert>* zoneAlerts = nullptr) {
+  if (!weatherData) weatherData.emplace(wordWrap);
+
+  const HttpResponse* failed = nullptr;
+  if (forecast && !forecast->ok()) {
+    weatherData->clearForecast();
+    failed = forecast;
+  } else if (forecast && !forecast->notModified()) {
+    extractFeed(
+        [&] { weatherData->updateForecast(feedDocument(*forecast)); });
+  } else if (forecast && !weatherData->hasForecast()) {
+    throw WeatherError(ErrorCause::BAD_DATA,
+                       "304 Not Modified without a cached forecast");
+  }
+
+  if (hourly && !hourly->ok()) {
+    weatherData->clearHourly();
+    failed = hourly;
+  } else if (hourly && !hourly->notModified()) {
+    extractFeed([&] { weatherData->updateHourly(feedDocument(*hourly)); });
+  } else if (hourly && !weatherData->hasHourly()) {
+    throw WeatherError(ErrorCause::BAD_DATA,
+                       "304 Not Modified without a cached hourly forecast");
+  }
+
+  if (alerts && !alerts->ok()) {
+    weatherData->clearAlerts();
+    failed = alerts;
+  } else if (alerts && !alerts->notModified() && zoneAlerts) {
+    weatherData->setAlerts(std::move(*zoneAlerts));
+  } else if (alerts && !alerts->notModified()) {
+    extractFeed([&] { weatherData->updateAlerts(feedDocument(*alerts)); });
+  } else if (alerts && !weatherData->hasAlerts()) {
+    throw WeatherError(ErrorCause::BAD_DATA,
+                       "304 Not Modified without cached alerts");
+  }
+  return failed;
+}
+
+// NWS endpoint `url` belongs to, so request metrics are kept per kind of
+// request rather than per URL.
+inline const char* endpointName(const std::string& url) {
+  const std::string target = HttpTransport::requestTarget(url);
+  if (target.compare(0, 8, "/alerts/") == 0) return "alerts";
+  if (target.compare(0, 8, "/points/") == 0) return "points";
+  if (target.compare(0, 12, "/gridpoints/") == 0) return "forecast";
+  if (target.find("ndfdXMLclient") != std::string::npos) return "zip_lookup";
+  return "other";
+}
+
+// Help text for every metric the pollers export.
+inline void describeMetrics(Metrics& metrics) {
+  metrics.describe("weather_http_phase_seconds",
+                   "Time per request phase (dns, connect and tls only for "
+                   "new connections; wait is time to first byte).");
+  metrics.describe("weather_http_request_seconds",
+                   "Total time per request, by endpoint and location.");
+  metrics.describe("weather_http_requests_total",
+                   "Completed requests by endpoint and status code.");
+  metrics.describe("weather_http_body_bytes_total",
+                   "Response body bytes after content decoding, by endpoint.");
+  metrics.describe("weather_http_wire_bytes_total",
+                   "Response body bytes as transferred (compressed), by "
+                   "endpoint.");
+  metrics.describe("weather_http_header_bytes_total",
+                   "Response header bytes received, by endpoint.");
+  metrics.describe("weather_update_seconds",
+                   "Time to extract parsed feeds into forecasts and alerts.");
+  metrics.describe("weather_render_seconds",
+                   "Time to render one poll's report or record.");
+  metrics.describe("weather_errors_total", "Failed polls by cause.");
+  metrics.describe("weather_shared_cache_hits_total",
+                   "Requests answered from the shared cache, by endpoint.");
+}
+
+// Adds one completed request (status received) for `location` to `metrics`.
+inline void recordRequest(Metrics& metrics, const std::string& url,
+                          const std::string& location,
+                          const HttpResponse& response) {
+  if (!response.status) return;  // Transfer failed; counted as an error
+  const std::string endpoint = Metrics::label("endpoint", endpointName(url));
+  const RequestTiming& t = response.timing;
+  auto phase = [&](const char* name, double seconds) {
+    metrics.observe("weather_http_phase_seconds",
+                    endpoint + "," + Metrics::label("phase", name), seconds);
+  };
+  if (t.newConnection) {
+    phase("dns", t.dns);
+    phase("connect", t.connect);
+    phase("tls", t.tls);
+  }
+  phase("wait", t.wait);
+  phase("transfer", t.transfer);
+  if (t.parse > 0) phase("parse", t.parse);
+  metrics.observe("weather_http_request_seconds",
+                  endpoint + "," + Metrics::label("location", location),
+                  t.total);
+  metrics.add("weather_http_requests_total",
+              endpoint + "," +
+                  Metrics::label("status", std::to_string(response.status)));
+  metrics.add("weather_http_body_bytes_total", endpoint,
+              static_cast<double>(t.bodyBytes));
+  metrics.add("weather_http_wire_bytes_total", endpoint,
+              static_cast<double>(t.wireBytes));
+  metrics.add("weather_http_header_bytes_total", endpoint,
+              static_cast<double>(t.headerBytes));
+}
+
+inline void recordError(Metrics& metrics, const std::exception& e) {
+  metrics.add("weather_errors_total",
+              Metrics::label("cause", causeName(classifyError(e))));
+}
+
+struct MonitoredLocation {
+  std::string zipCode;
+  std::string city;
+  std::string state;
+  std::string forecast_api;
+  std::string alerts_api;
+  std::string hourly_api;  // Empty unless the hourly forecast is polled
+  // County, forecast and fire weather zone codes for --national-alerts
+  std::vector<std::string> alert_zones;
+};
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// What one location shows between polls: its parsed feeds and the alerts
+// already reported.
+class LocationReport {
+ public:
+  // Where the last poll's processing time went, in seconds.
+  struct Timing {
+    double update{0};  // Parsed documents into WeatherData
+    double render{0};  // Report text or NDJSON record
+  };
+
+  LocationReport(bool wordWrap, bool allAlerts,
+                 OutputFormat format = OutputFormat::TEXT)
+      : wordWrap(wordWrap), allAlerts(allAlerts), format(format) {}
+
+  // Applies one poll (nullptr for a feed that was not polled; `hourly`
+  // comes with forecast polls when it is used; `zoneAlerts` with alerts
+  // taken from the national feed). As text,
+  // writes `heading` plus the report to `out`: a forecast poll renders
+  // everything, an alerts-only poll renders only alert changes and writes
+  // nothing when there are none. As NDJSON nothing is written here; call
+  // writeRecord() once the outcome of the poll is known. Returns the feed
+  // that failed (nullptr if none); bad data throws WeatherError and the
+  // caller should reset().
+  const HttpResponse* apply(HttpResponse* forecast, HttpResponse* alerts,
+                            int periods, const std::string& heading,
+                            std::ostream& out,
+                            HttpResponse* hourly = nullptr,
+                            std::vector<WeatherAlert>* zoneAlerts = nullptr) {
+    changes.reset();
+    timing = Timing();
+    const auto start = std::chrono::steady_clock::now();
+    const HttpResponse* failed = updateWeatherData(
+        weatherData, forecast, alerts, wordWrap, hourly, zoneAlerts);
+    timing.update = secondsSince(start);
+    // Windows start now, so rules are rechecked even if nothing changed
+    if (forecast) evaluateRules();
+    if ((!forecast || !forecast->ok()) && (!alerts || !alerts->ok()))
+      return failed;  // Nothing new to show
+
+    if (!allAlerts) {
+      if (alerts && weatherData->hasAlerts())
+        changes = tracker.update(weatherData->getAlerts());
+      else
+        changes.emplace();  // Alerts not polled: nothing changed
+    }
+    if (format == OutputFormat::NDJSON) return failed;
+    const AlertChanges* shown = changes ? &*changes : nullptr;
+
+    const auto renderStart = std::chrono::steady_clock::now();
+    if (forecast) {
+      out << heading;
+      weatherData->render(out, periods, shown);
+      renderRules(out);
+      out << "---\n";
+    } else if (!shown || !shown->empty()) {
+      out << heading;
+      weatherData->renderAlerts(out, shown);
+      out << "---\n";
+    }
+    timing.render = secondsSince(renderStart);
+    return failed;
+  }
+
+  // One NDJSON line for the poll last passed to apply(): which feeds were
+  // polled, `error` ("" when none), the alert changes and everything
+  // currently known about the location.
+  void writeRecord(std::ostream& out, const MonitoredLocation& location,
+                   bool forecastPolled, bool alertsPolled,
+                   const std::string& error) {
+    const auto start = std::chrono::steady_clock::now();
+    bj::object record;
+    record["time"] = getIsoTimeStamp();
+    record["zipCode"] = location.zipCode;
+    record["city"] = location.city;
+    record["state"] = location.state;
+    bj::array polled;
+    if (forecastPolled) polled.emplace_back("forecast");
+    if (forecastPolled && !location.hourly_api.empty())
+      polled.emplace_back("hourly");
+    if (alertsPolled) polled.emplace_back("alerts");
+    record["polled"] = std::move(polled);
+    const auto end = error.find_last_not_of(" \n");
+    if (end == std::string::npos)
+      record["error"] = nullptr;
+    else
+      record["error"] = error.substr(0, end + 1);
+    if (changes) {
+      bj::object changed;
+      changed["added"] = alertSummaries(changes->added);
+      changed["updated"] = alertSummaries(changes->updated);
+      bj::array expired;
+      for (const auto& alert : changes->expired) {
+        bj::object summary;
+        summary["id"] = alert.id;
+        summary["event"] = alert.event;
+        expired.push_back(std::move(summary));
+      }
+      changed["expired"] = std::move(expired);
+      changed["unchanged"] = changes->unchanged;
+      record["changes"] = std::move(changed);
+    }
+    if (weatherData)
+      record["weather"] = weatherData->toJson();
+    else
+      record["weather"] = nullptr;
+    if (rules) record["rules"] = ruleNames();
+    out << bj::serialize(record) << '\n';
+    timing.render += secondsSince(start);
+  }
+
+  // Drops the parsed feeds (not the alert index) after bad data.
+  void reset() {
+    weatherData.reset();
+    matched.clear();
+  }
+
+  // Checks `rules` on every forecast poll; nullptr for none.
+  void useRules(const RuleSet* set) { rules = set; }
+
+  // "Rules matched: ..." after a report, if any rule matched at the last
+  // forecast poll.
+  void renderRules(std::ostream& out) const {
+    if (matched.empty()) return;
+    out << "\nRules matched: ";
+    for (std::size_t i = 0; i < matched.size(); i++)
+      out << (i ? ", " : "") << rules->name(matched[i]);
+    out << "\n";
+  }
+
+  // Names of the rules that matched at the last forecast poll.
+  bj::array ruleNames() const {
+    bj::array names;
+    for (std::size_t rule : matched) names.emplace_back(rules->name(rule));
+    return names;
+  }
+
+  // Feeds as of the last apply(), or nullptr before the first one.
+  WeatherData* data() { return weatherData ? &*weatherData : nullptr; }
+
+  // Of the last apply() and writeRecord().
+  const Timing& lastTiming() const { return timing; }
+
+ private:
+  bool wordWrap;
+  bool allAlerts;
+  OutputFormat format;
+  std::optional<WeatherData> weatherData;
+  AlertTracker tracker;
+  // Changes found by the last apply(); they point into weatherData
+  std::optional<AlertChanges> changes;
+  Timing timing;
+  const RuleSet* rules{nullptr};
+  std::vector<std::size_t> matched;  // Indexes into *rules
+
+  void evaluateRules() {
+    matched.clear();
+    if (!rules || !weatherData->hasForecast()) return;
+    const RuleData& data = weatherData->getRuleData();
+    const std::int64_t now =
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    for (std::size_t rule = 0; rule < rules->size(); rule++)
+      if (rules->matches(rule, data, now)) matched.push_back(rule);
+  }
+
+  static bj::array alertSummaries(const std::vector<const WeatherAlert*>& list) {
+    bj::array summaries;
+    for (const auto* alert : list) {
+      bj::object summary;
+      summary["id"] = alert->id;
+      summary["event"] = alert->event;
+      summary["severity"] = alert->severity;
+      summary["headline"] = alert->headline;
+      summary["expires"] = alert->expires;
+      summaries.push_back(std::move(summary));
+    }
+    return summaries;
+  }
+};
+
+// Adds the processing time of `report`'s last poll to `metrics`.
+inline void recordReport(Metrics& metrics, const std::string& location,
+                         const LocationReport& report) {
+  const std::string label = Metrics::label("location", location);
+  metrics.observe("weather_update_seconds", label,
+                  report.lastTiming().update);
+  metrics.observe("weather_render_seconds", label,
+                  report.lastTiming().render);
+}
+
+// Appends the feeds of one poll that brought new data (not a 304 or a
+// failure) to `history`, and compacts it when that is due. Returns false if
+// it could not be written.
+inline bool recordHistory(HistoryStore& history, const std::string& location,
+                          LocationReport& report, const HttpResponse* forecast,
+                          const HttpResponse* alerts) {
+  WeatherData* data = report.data();
+  if (!data) return true;
+  const std::int64_t now = HistoryStore::now();
+  bool written = true;
+  if (forecast && forecast->ok() && !forecast->notModified() &&
+      data->hasForecast())
+    written &= history.append(
+        ForecastSnapshot{now, location, data->getPeriods()});
+  if (alerts && alerts->ok() && !alerts->notModified() && data->hasAlerts())
+    written &= history.append(AlertSnapshot{now, location, data->getAlerts()});
+  return history.compactIfDue(now) && written;
+}
+
+// Drives any number of locations from a single thread. Every location has
+// separate forecast and alerts timers in one TimerQueue; due feeds have
+// their requests added to one curl multi handle so all transfers are in
+// flight at the same time. Feeds started together are rendered together.
+// With useNationalAlerts() a single national alerts timer replaces the
+// per-location ones and AlertIndex hands each location its share.
+class WeatherMonitor {
+ public:
+  using Clock = TimerQueue::Clock;
+
+  WeatherMonitor(WeatherSettings& settings, bool wordWrap, bool allAlerts,
+                 OutputFormat format = OutputFormat::TEXT)
+      : settings(settings),
+        wordWrap(wordWrap),
+        allAlerts(allAlerts),
+        format(format),
+        multi(curl_multi_init()) {
+    if (!multi) throw std::runtime_error("Failed to initialize cURL multi.");
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    describeMetrics(metrics);
+  }
+
+  WeatherMonitor(const WeatherMonitor&) = delete;
+  WeatherMonitor& operator=(const WeatherMonitor&) = delete;
+
+  ~WeatherMonitor() {
+    for (auto& location : locations) {
+      cancel(location.forecast);
+      cancel(location.alerts);
+      cancel(location.hourly);
+    }
+    cancel(national);
+    curl_multi_cleanup(multi);
+  }
+
+  // Locations must all be added before run() is called.
+  void addLocation(const MonitoredLocation& location) {
+    locations.emplace_back(location, wordWrap, allAlerts, format);
+    locations.back().report.useRules(rules);
+    const std::size_t index = locations.size() - 1;
+    locations.back().forecast.owner = index;
+    locations.back().alerts.owner = index;
+    locations.back().hourly.owner = index;
+    if (nationalAlerts) {
+      // Forecasts start once the first national feed is in, see
+      // finishNational()
+      alertIndex.subscribe(index, AlertIndex::zoneOf(location.alerts_api));
+      for (const auto& zone : location.alert_zones)
+        alertIndex.subscribe(index, zone);
+      if (!nationalDue) nationalDue = Clock::now();
+      return;
+    }
+    // Don't start thousands of locations in the same instant
+    const auto start = Clock::now() + PollSchedule::startupOffset(index);
+    timers.schedule(timerKey(index, FORECAST), start);
+    timers.schedule(timerKey(index, ALERTS), start);
+  }
+
+  std::size_t size() const { return locations.size(); }
+
+  // After every successful batch, also publish the location's full report
+  // to `store`, which must have a slot per location.
+  void publishTo(SnapshotStore* store) { snapshots = store; }
+
+  // Check `set` for every location added after this call.
+  void useRules(const RuleSet* set) { rules = set; }
+
+  // Fetch the national alerts feed once per alert interval for every
+  // location added after this call, instead of one request per location.
+  void useNationalAlerts() { nationalAlerts = true; }
+
+  // Also append every poll's new forecasts and alerts to `store`.
+  void keepHistory(HistoryStore* store) { history = store; }
+
+  // Also keep `file` up to date with the metrics in Prometheus text format.
+  void exportMetrics(std::filesystem::path file) {
+    metrics_file = std::move(file);
+  }
+
+  // Runs the event loop forever. Whatever the locations finished in one
+  // iteration print is written in one go.
+  void run() {
+    while (true) iterate();
+  }
+
+  // Polls every location once instead (still staggered) and returns how
+  // many of them failed.
+  std::size_t runOnce() {
+    once = true;
+    while (finished < locations.size()) iterate();
+    metrics_published = Clock::time_point();  // Export the final numbers
+    publishMetrics();
+    errors.flush();
+    return failed;
+  }
+
+ private:
+  enum Feed : std::size_t { FORECAST = 0, ALERTS = 1 };
+  // The hourly forecast has no timer of its own: it is fetched with every
+  // forecast poll, into this parser slot.
+  static inline const std::size_t HOURLY_SLOT = 2;
+
+  struct Transfer {
+    std::size_t owner{};
+    CURL* handle{nullptr};
+    curl_slist* request_headers{nullptr};
+    std::string url;
+    HttpResponse response;
+    bool polled{false};  // Part of the batch being collected
+    PollSchedule schedule;
+  };
+
+  struct LocationState {
+    LocationState(const MonitoredLocation& info, bool wordWrap,
+                  bool allAlerts, OutputFormat format)
+        : info(info), report(wordWrap, allAlerts, format) {}
+
+    MonitoredLocation info;
+    LocationReport report;
+    ParseArena arena;  // Holds the documents of the batch in flight
+    Transfer forecast;
+    Transfer alerts;
+    Transfer hourly;  // Only used when info.hourly_api is set
+    int pending{0};
+    bool held{false};     // By startDueFeeds(), counted in pending
+    bool started{false};  // Its first forecast poll was started
+    // runOnce() counts a location once, however many batches it takes
+    bool done{false};
+    bool failed{false};
+    // This location's part of the national feed, for the next finish()
+    std::vector<WeatherAlert> zoneAlerts;
+  };
+
+  // Upper bound for a single transfer so one stuck request can't stall its
+  // location forever.
+  static inline const long TRANSFER_TIMEOUT_SECONDS = 60;
+  // Set by runOnce(): locations are not polled again
+  bool once{false};
+  std::size_t finished{0};
+  std::size_t failed{0};
+
+  // Longest the loop sleeps before re-checking the timers.
+  static inline const int MAX_POLL_MS = 1000;
+  // Metrics are exported at most this often, however many polls finish.
+  static inline const std::chrono::seconds METRICS_INTERVAL{5};
+
+  WeatherSettings& settings;
+  bool wordWrap;
+  bool allAlerts;
+  OutputFormat format;
+  HttpClient httpClient;
+  CURLM* multi;
+  OutputFrame output{stdout};
+  OutputFrame errors{stderr};
+  TimerQueue timers;
+  std::deque<LocationState> locations;  // deque: elements never move
+  SnapshotStore* snapshots{nullptr};
+  HistoryStore* history{nullptr};
+  const RuleSet* rules{nullptr};
+  Metrics metrics;
+  std::filesystem::path metrics_file;
+  Clock::time_point metrics_published{};
+  bool metrics_changed{false};
+  // National alerts (useNationalAlerts()): one feed, indexed by zone
+  bool nationalAlerts{false};
+  Transfer national;
+  // On the heap: the document is megabytes and only parsed every few
+  // minutes, not worth keeping a buffer that size around
+  ParseArena nationalArena{0};
+  AlertIndex alertIndex;
+  std::optional<Clock::time_point> nationalDue;
+  bool deliverAll{true};  // Next fan-out reaches every location
+  bool forecastsScheduled{false};
+
+  static std::size_t timerKey(std::size_t location, Feed feed) {
+    return location * 2 + feed;
+  }
+
+  void startDueFeeds() {
+    const auto now = Clock::now();
+    if (nationalDue && *nationalDue <= now) {
+      nationalDue.reset();
+      startNational();
+    }
+    // Every location started here is held until all due feeds are, so
+    // feeds answered right away (see launch()) don't finish a batch early
+    // and a location due for both feeds finishes once
+    std::vector<LocationState*> held;
+    while (auto key = timers.popDue(now)) {
+      LocationState& location = locations[*key / 2];
+      if (!location.held) {
+        // The previous batch's documents were consumed by finish()
+        if (!location.pending) location.arena.release();
+        location.held = true;
+        ++location.pending;
+        held.push_back(&location);
+      }
+      if (*key % 2 == FORECAST) {
+        location.started = true;
+        start(location, location.forecast, location.info.forecast_api,
+              location.arena.parser(FORECAST));
+        if (!location.info.hourly_api.empty())
+          start(location, location.hourly, location.info.hourly_api,
+                location.arena.parser(HOURLY_SLOT));
+      } else
+        start(location, location.alerts, location.info.alerts_api,
+              location.arena.parser(ALERTS));
+    }
+    for (LocationState* location : held) {
+      location->held = false;
+      if (--location->pending == 0) finish(*location);
+    }
+  }
+
+  void start(LocationState& location, Transfer& transfer,
+             const std::string& url, bj::stream_parser& parser) {
+    transfer.polled = true;
+    ++location.pending;
+    if (!launch(transfer, url, parser) && --location.pending == 0)
+      finish(location);
+  }
+
+  void startNational() {
+    // The previous document was consumed by finishNational()
+    nationalArena.release();
+    if (!launch(national, AlertIndex::NATIONAL_URL, nationalArena.parser(0)))
+      finishNational();
+  }
+
+  // Adds the request for `url` to the multi handle. False when
+  // transfer.response is already final: answered from the shared cache, or
+  // the request could not be created.
+  bool launch(Transfer& transfer, const std::string& url,
+              bj::stream_parser& parser) {
+    transfer.response = HttpResponse();
+    transfer.url = url;
+    if (httpClient.fromSharedCache(url, transfer.response, &parser)) {
+      metrics.add("weather_shared_cache_hits_total",
+                  Metrics::label("endpoint", endpointName(url)));
+      metrics_changed = true;
+      return false;
+    }
+    transfer.handle = curl_easy_init();
+    if (!transfer.handle) {
+      transfer.response.error = "Failed to initialize cURL for URL: " + url;
+      return false;
+    }
+    httpClient.configure(transfer.handle, url, &transfer.response, &parser);
+    transfer.request_headers = httpClient.conditionalHeaders(url);
+    curl_easy_setopt(transfer.handle, CURLOPT_HTTPHEADER,
+                     transfer.request_headers);
+    curl_easy_setopt(transfer.handle, CURLOPT_PRIVATE, &transfer);
+    curl_easy_setopt(transfer.handle, CURLOPT_TIMEOUT,
+                     TRANSFER_TIMEOUT_SECONDS);
+    curl_multi_add_handle(multi, transfer.handle);
+    return true;
+  }
+
+  void cancel(Transfer& transfer) {
+    if (!transfer.handle) return;
+    curl_multi_remove_handle(multi, transfer.handle);
+    curl_easy_cleanup(transfer.handle);
+    curl_slist_free_all(transfer.request_headers);
+    transfer.handle = nullptr;
+    transfer.request_headers = nullptr;
+  }
+
+  void collectFinishedTransfers() {
+    int queued = 0;
+    while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      Transfer* transfer = nullptr;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+      const bool isNational = transfer == &national;
+      LocationState* location =
+          isNational ? nullptr : &locations[transfer->owner];
+      if (msg->data.result != CURLE_OK) {
+        HttpClient::fail(transfer->response, transfer->url,
+                         msg->data.result);
+      } else {
+        httpClient.complete(msg->easy_handle, transfer->url,
+                            transfer->response);
+        recordRequest(metrics, transfer->url,
+                      isNational ? "all" : location->info.zipCode,
+                      transfer->response);
+      }
+      cancel(*transfer);
+
+      if (isNational)
+        finishNational();
+      else if (--location->pending == 0)
+        finish(*location);
+    }
+  }
+
+  void iterate() {
+    startDueFeeds();
+
+    int running = 0;
+    curl_multi_perform(multi, &running);
+    collectFinishedTransfers();
+    publishMetrics();
+    output.flush();
+    errors.flush();
+
+    curl_multi_poll(multi, nullptr, 0, pollTimeoutMs(), nullptr);
+  }
+
+  // Renders a location once every transfer of its batch is complete and
+  // arms the next timer of each polled feed as its PollSchedule says.
+  void finish(LocationState& location) {
+    std::ostream& out = output.out();
+    std::string error;
+    HttpResponse* forecast =
+        location.forecast.polled ? &location.forecast.response : nullptr;
+    HttpResponse* alerts =
+        location.alerts.polled ? &location.alerts.response : nullptr;
+    HttpResponse* hourly =
+        location.hourly.polled ? &location.hourly.response : nullptr;
+    const bool forecastPolled = forecast, alertsPolled = alerts;
+    // The hourly forecast shares the forecast's timer and its failures
+    bool forecastFailed =
+        (forecast && !forecast->ok()) || (hourly && !hourly->ok());
+    bool alertsFailed = alerts && !alerts->ok();
+    const std::string heading = "Weather for: \t" + location.info.city +
+                                ", " + location.info.state + " (" +
+                                location.info.zipCode + ")\nRun: \t\t" +
+                                getCurrentTimeStamp() + "\n";
+    bool applied = false;
+    ErrorCause dataCause = ErrorCause::OTHER;
+    try {
+      const HttpResponse* failed = location.report.apply(
+          forecast, alerts, settings.getPeriods(), heading, out, hourly,
+          nationalAlerts ? &location.zoneAlerts : nullptr);
+      applied = true;
+      if (history &&
+          !recordHistory(*history, location.info.zipCode, location.report,
+                         forecast, alerts))
+        errors.out() << "Could not write history\n";
+      if (failed) throw WeatherError(failed->cause, failed->error);
+      if (snapshots) publish(location);
+    } catch (const std::exception& e) {
+      recordError(metrics, e);
+      if (!forecastFailed && !alertsFailed) {
+        // Bad data: start over with full downloads of both feeds rather
+        // than trusting a stale cache
+        location.report.reset();
+        httpClient.forgetValidators(location.info.forecast_api);
+        httpClient.forgetValidators(location.info.alerts_api);
+        httpClient.forgetValidators(location.info.hourly_api);
+        forecastFailed = alertsFailed = true;
+        forecast = &location.forecast.response;
+        if (nationalAlerts) {
+          // Its alerts are gone too; the next national feed restores them
+          httpClient.forgetValidators(AlertIndex::NATIONAL_URL);
+          deliverAll = true;
+        } else {
+          alerts = &location.alerts.response;
+        }
+        dataCause = classifyError(e);
+      }
+      error = describeWeatherError(e);
+    }
+
+    const std::size_t index = location.forecast.owner;
+    const auto now = Clock::now();
+    const auto retry = std::chrono::minutes(settings.getRetry());
+    Clock::duration retryIn = Clock::duration::max();
+    if (once) {
+      if (!location.done) ++finished;
+      if (!error.empty() && !location.failed) ++failed;
+      location.done = true;
+      location.failed = location.failed || !error.empty();
+      forecast = alerts = nullptr;  // Nothing to schedule
+    }
+    if (forecast) {
+      const HttpResponse& outcome =
+          hourly && !hourly->ok() ? *hourly : *forecast;
+      auto delay = location.forecast.schedule.next(
+          outcome, forecastFailed, dataCause,
+          std::chrono::minutes(settings.getDelay()), retry);
+      timers.schedule(timerKey(index, FORECAST), now + delay);
+      if (forecastFailed) retryIn = std::min(retryIn, delay);
+    }
+    if (alerts && nationalAlerts) {
+      if (alertsFailed && nationalDue)
+        retryIn = std::min(retryIn, *nationalDue - now);
+    } else if (alerts) {
+      auto delay = location.alerts.schedule.next(
+          *alerts, alertsFailed, dataCause,
+          std::chrono::minutes(settings.getAlertInterval()), retry);
+      timers.schedule(timerKey(index, ALERTS), now + delay);
+      if (alertsFailed) retryIn = std::min(retryIn, delay);
+    }
+
+    if (format == OutputFormat::NDJSON)
+      location.report.writeRecord(out, location.info, forecastPolled,
+                                  alertsPolled, error);
+    else if (once && !error.empty())
+      errors.out() << "[" << location.info.zipCode << "] " << error
+                   << (error.back() == '\n' ? "" : "\n");
+    else if (!error.empty())
+      errors.out() << "[" << location.info.zipCode << "] " << error
+                   << "Retrying in " << describeDelay(retryIn) << ". . .\n";
+    if (applied)
+      recordReport(metrics, location.info.zipCode, location.report);
+    metrics_changed = true;
+
+    location.forecast.response = HttpResponse();
+    location.alerts.response = HttpResponse();
+    location.hourly.response = HttpResponse();
+    location.forecast.polled = location.alerts.polled =
+        location.hourly.polled = false;
+    location.zoneAlerts.clear();
+  }
+
+  // Indexes a national feed and hands every location whose alerts may have
+  // changed its own, as if it had polled them. A location busy with a
+  // forecast poll gets them with that; before the first one they wait
+  // for it, so every location starts with a complete report.
+  void finishNational() {
+    HttpResponse& response = national.response;
+    ErrorCause dataCause = ErrorCause::OTHER;
+    if (response.ok() && !response.notModified()) {
+      try {
+        extractFeed([&] { alertIndex.update(feedDocument(response)); });
+      } catch (const std::exception& e) {
+        // Every location reports it as its own failure
+        dataCause = classifyError(e);
+        response.error = e.what();
+        response.cause = dataCause;
+      }
+    }
+    const bool failed = !response.ok();
+    if (failed) httpClient.forgetValidators(national.url);
+
+    const auto now = Clock::now();
+    if (!once)
+      nationalDue =
+          now + national.schedule.next(
+                    response, failed, dataCause,
+                    std::chrono::minutes(settings.getAlertInterval()),
+                    std::chrono::minutes(settings.getRetry()));
+
+    auto deliver = [&](std::size_t index, std::vector<WeatherAlert> alerts) {
+      LocationState& location = locations[index];
+      WeatherData* data = location.report.data();
+      if (!failed && location.started && data && data->hasAlerts() &&
+          sameAlerts(data->getAlerts(), alerts))
+        return;  // Nothing to report
+      location.zoneAlerts = std::move(alerts);
+      HttpResponse& delivered = location.alerts.response;
+      delivered = HttpResponse();
+      delivered.status = failed ? response.status : 200;
+      delivered.error = response.error;
+      delivered.cause = response.cause;
+      location.alerts.polled = true;
+      if (location.started && !location.pending) finish(location);
+    };
+    if (failed) {
+      for (std::size_t i = 0; i < locations.size(); i++) deliver(i, {});
+      deliverAll = true;
+    } else if (deliverAll) {
+      deliverAll = false;  // Unless bad data in a location sets it again
+      alertIndex.fanOutAll(deliver);
+    } else if (!response.notModified()) {
+      alertIndex.fanOut(deliver);
+    }
+    response = HttpResponse();
+
+    // The forecasts of a new monitor wait for the first national feed
+    if (forecastsScheduled) return;
+    forecastsScheduled = true;
+    for (std::size_t i = 0; i < locations.size(); i++)
+      timers.schedule(timerKey(i, FORECAST),
+                      now + PollSchedule::startupOffset(i));
+  }
+
+  static bool sameAlerts(const std::vector<WeatherAlert>& a,
+                         const std::vector<WeatherAlert>& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); i++)
+      if (a[i].id != b[i].id) return false;
+    return true;
+  }
+
+  // Renders the complete report (every active alert, not only changes) once
+  // here so readers of the snapshot never render anything themselves.
+  void publish(LocationState& location) {
+    WeatherData* data = location.report.data();
+    if (!data) return;
+    const MonitoredLocation& info = location.info;
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->zipCode = info.zipCode;
+
+    std::ostringstream text;
+    text << "Weather for: \t" << info.city << ", " << info.state << " ("
+         << info.zipCode << ")\nRun: \t\t" << getCurrentTimeStamp() << "\n";
+    data->render(text, settings.getPeriods());
+    location.report.renderRules(text);
+    text << "---\n";
+    snapshot->text = text.str();
+
+    bj::object root;
+    root["zipCode"] = info.zipCode;
+    root["city"] = info.city;
+    root["state"] = info.state;
+    root["weather"] = data->toJson();
+    if (rules) root["rules"] = location.report.ruleNames();
+    snapshot->json = bj::serialize(root);
+
+    snapshots->publish(location.forecast.owner, std::move(snapshot));
+  }
+
+  // Writes the metrics file and the /metrics snapshot, if either is wanted,
+  // when something changed and the last export is old enough.
+  void publishMetrics() {
+    if (!metrics_changed || (metrics_file.empty() && !snapshots)) return;
+    const auto now = Clock::now();
+    if (now - metrics_published < METRICS_INTERVAL) return;
+    metrics_published = now;
+    metrics_changed = false;
+
+    if (!metrics_file.empty() && !metrics.writeFile(metrics_file))
+      errors.out() << "Could not write metrics to " << metrics_file.string()
+                   << "\n";
+    if (snapshots) {
+      auto snapshot = std::make_unique<Snapshot>();
+      snapshot->text = metrics.text();
+      snapshots->publishMetrics(std::move(snapshot));
+    }
+  }
+
+  int pollTimeoutMs() {
+    auto timeout = std::chrono::milliseconds(MAX_POLL_MS);
+    auto due = timers.nextDue();
+    if (nationalDue && (!due || *nationalDue < *due)) due = nationalDue;
+    if (due) {
+      timeout = std::max(
+          std::chrono::milliseconds(0),
+          std::min(timeout,
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                       *due - Clock::now())));
+    }
+    long curlTimeout = -1;
+    curl_multi_timeout(multi, &curlTimeout);
+    if (curlTimeout >= 0 && curlTimeout < timeout.count())
+      return static_cast<int>(curlTimeout);
+    return static_cast<int>(timeout.count());
+  }
+};
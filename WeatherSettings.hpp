@@ -6,6 +6,10 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+
+#include "ParseArena.hpp"
 
 namespace fs = std::filesystem;
 namespace bj = boost::json;
@@ -18,43 +22,59 @@ class WeatherSettings {
     const fs::path exePath = getExecuatablePath();
     settings_file = exePath.parent_path() / "settings.json";
   }
+  // Settings kept somewhere other than next to the executable
+  explicit WeatherSettings(fs::path file) : settings_file(std::move(file)) {}
   std::string getZipCode() { return zipCode; }
+  std::vector<std::string> getZipCodes() { return zipCodes; }
   int getDelay() { return delay; }
   int getRetry() { return retry; }
+  // 0 means alerts are polled together with the forecast
+  int getAlertInterval() { return alertInterval ? alertInterval : delay; }
   int getPeriods() { return periods; }
   std::string getForecastAPI() { return forecastAPI; }
   std::string getAlertsAPI() { return alertsAPI; }
   std::string getCity() { return city; }
   std::string getState() { return state; }
   void setZipCode(std::string passedZipCode) { zipCode = passedZipCode; }
+  void setZipCodes(std::vector<std::string> passedZipCodes) {
+    zipCodes = passedZipCodes;
+  }
   void setDelay(int passedDelay) { delay = passedDelay; }
   void setRetry(int passedRetry) { retry = passedRetry; }
+  void setAlertInterval(int passedInterval) { alertInterval = passedInterval; }
   void setForecastPeriods(int passedPeriods) { periods = passedPeriods; }
   void setForecastAPI(std::string input) { forecastAPI = input; }
   void setAlertsAPI(std::string input) { alertsAPI = input; }
   void setCity(std::string input) { city = input; }
   void setState(std::string input) { state = input; }
-  void saveSettings() {
+  // Writes the settings unless the file already holds exactly them, so a
+  // run that changed nothing doesn't rewrite it. Returns whether it wrote.
+  bool saveSettings() {
     bj::object obj;
     obj["zipCode"] = zipCode;
+    bj::array zipArray;
+    for (const auto& zip : zipCodes) zipArray.emplace_back(zip);
+    obj["zipCodes"] = zipArray;
     obj["delay"] = delay;
     obj["retry"] = retry;
+    obj["alertInterval"] = alertInterval;
     obj["periods"] = periods;
     obj["forecastAPI"] = forecastAPI;
     obj["alertsAPI"] = alertsAPI;
     obj["city"] = city;
     obj["state"] = state;
-    std::string json = bj::serialize(obj);
+    std::ostringstream text;
+    pretty_print(text, obj);
+    if (text.str() == saved_text) return false;
     std::ofstream outfile(settings_file, std::ios::out);
     if (outfile.is_open()) {
-      //outfile << json;
-      pretty_print(outfile, obj);
-      // outfile.close(); //This can be omitted since the destructor will handle
-      // it.
-    } else {
-      std::cerr << "Error opening " << settings_file << " for writing."
-                << std::endl;
+      outfile << text.str();
+      saved_text = text.str();
+      return true;
     }
+    std::cerr << "Error opening " << settings_file << " for writing."
+              << std::endl;
+    return false;
   }
   void loadSettings() {
     if (settingsFileExists()) {
@@ -64,9 +84,11 @@ class WeatherSettings {
       buffer << ifile.rdbuf();
       std::string json = buffer.str();
       ifile.close();
+      saved_text = json;
 
-      bj::value jv = bj::parse(json);
-      bj::object obj = jv.as_object();
+      ParseArena arena(4 * 1024);
+      bj::value jv = bj::parse(json, arena.storage());
+      const bj::object& obj = jv.as_object();
       zipCode = obj.at("zipCode").as_string();
       delay = static_cast<int>(obj.at("delay").as_int64());
       retry = static_cast<int>(obj.at("retry").as_int64());
@@ -75,6 +97,16 @@ class WeatherSettings {
       alertsAPI = static_cast<std::string>(obj.at("alertsAPI").as_string());
       city = static_cast<std::string>(obj.at("city").as_string());
       state = static_cast<std::string>(obj.at("state").as_string());
+      // zipCodes and alertInterval are optional so settings files from older
+      // versions still load
+      alertInterval = 0;
+      if (auto interval = obj.if_contains("alertInterval"))
+        alertInterval = static_cast<int>(interval->as_int64());
+      zipCodes.clear();
+      if (auto zipArray = obj.if_contains("zipCodes")) {
+        for (auto& zip : zipArray->as_array())
+          zipCodes.emplace_back(zip.as_string().c_str());
+      }
     } else {
       // std::cout << "settings.json does not exist!n";
     }
@@ -91,6 +123,14 @@ class WeatherSettings {
     return fs::current_path();
 #endif
   }
+  // Optional offline ZIP table, kept next to settings.json
+  fs::path getGazetteerFile() {
+    return settings_file.parent_path() / "zipcodes.bin";
+  }
+  // ZIP -> endpoint cache (see LocationCache), kept next to settings.json
+  fs::path getLocationCacheFile() {
+    return settings_file.parent_path() / "locations.json";
+  }
   bool settingsFileExists() {
     if (fs::exists(settings_file)) {
       return true;
@@ -101,13 +141,17 @@ class WeatherSettings {
  private:
   fs::path settings_file;
   std::string zipCode{};
+  std::vector<std::string> zipCodes{};
   int delay{};
   int retry{};
+  int alertInterval{};
   int periods{};
   std::string city{};
   std::string state{};
   std::string forecastAPI{};
   std::string alertsAPI{};
+  // The file's contents as last loaded or saved
+  std::string saved_text;
   void
 pretty_print( std::ostream& os, bj::value const& jv, std::string* indent = nullptr )
 {
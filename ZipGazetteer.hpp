@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Exactly five ASCII digits. Checked by hand: a std::regex costs more to
+// construct than the rest of a cached start-up.
+inline bool isValidZipCode(std::string_view zipCode) {
+  if (zipCode.size() != 5) return false;
+  for (char c : zipCode)
+    if (c < '0' || c > '9') return false;
+  return true;
+}
+
+struct GazetteerEntry {
+  std::uint32_t zip{};
+  double latitude{};
+  double longitude{};
+};
+
+// Offline ZIP code -> lat/long table. The file is a 16 byte header ("WAZG",
+// version, record count, reserved) followed by fixed-width 12 byte records
+// sorted by ZIP: ZIP, latitude and longitude in 1/10000 degree, all 32-bit
+// little endian. It is memory-mapped and searched in place, so opening it
+// costs one mmap() regardless of its size. Build it with the zip-gazetteer
+// tool.
+class ZipGazetteer {
+ public:
+  static inline const std::uint32_t VERSION = 1;
+  static inline const std::size_t HEADER_SIZE = 16;
+  static inline const std::size_t RECORD_SIZE = 12;
+  static inline const double SCALE = 10000.0;
+
+  ZipGazetteer() = default;
+  explicit ZipGazetteer(const std::filesystem::path& path) { open(path); }
+  ZipGazetteer(const ZipGazetteer&) = delete;
+  ZipGazetteer& operator=(const ZipGazetteer&) = delete;
+  ~ZipGazetteer() { close(); }
+
+  // Returns false (and stays closed) when the file is missing or malformed.
+  bool open(const std::filesystem::path& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* mapped = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                          PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        data = static_cast<const unsigned char*>(mapped);
+        length = static_cast<std::size_t>(st.st_size);
+        mapped_file = true;
+      }
+    }
+    ::close(fd);
+#else
+    // No mmap here; the table is small enough to read in one go.
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+      fallback.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+      data = fallback.data();
+      length = fallback.size();
+    }
+#endif
+    if (!data || length < HEADER_SIZE || std::memcmp(data, "WAZG", 4) != 0 ||
+        readU32(data + 4) != VERSION ||
+        length != HEADER_SIZE + RECORD_SIZE * std::size_t{readU32(data + 8)}) {
+      close();
+      return false;
+    }
+    count = readU32(data + 8);
+    return true;
+  }
+
+  void close() {
+#ifndef _WIN32
+    if (mapped_file) munmap(const_cast<unsigned char*>(data), length);
+#else
+    fallback.clear();
+#endif
+    data = nullptr;
+    length = 0;
+    count = 0;
+    mapped_file = false;
+  }
+
+  bool isOpen() const { return data != nullptr; }
+
+  std::size_t size() const { return count; }
+
+  // Binary search over the mapped records.
+  std::optional<GazetteerEntry> find(std::uint32_t zip) const {
+    std::size_t low = 0, high = count;
+    while (low < high) {
+      std::size_t mid = low + (high - low) / 2;
+      std::uint32_t key = readU32(record(mid));
+      if (key < zip)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    if (low == count || readU32(record(low)) != zip) return std::nullopt;
+    const unsigned char* r = record(low);
+    return GazetteerEntry{zip, readI32(r + 4) / SCALE, readI32(r + 8) / SCALE};
+  }
+
+  // "lat,long" for a 5 digit ZIP code in the form the points API takes,
+  // or nullopt when the ZIP code is not in the table.
+  std::optional<std::string> latLong(const std::string& zipCode) const {
+    if (!isOpen() || !isValidZipCode(zipCode)) return std::nullopt;
+    std::uint32_t zip = 0;
+    for (char c : zipCode) zip = zip * 10 + static_cast<std::uint32_t>(c - '0');
+    auto entry = find(zip);
+    if (!entry) return std::nullopt;
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "%.4f,%.4f", entry->latitude,
+                  entry->longitude);
+    return std::string(buffer);
+  }
+
+  // Serializes `entries` in the format above; duplicates keep the first.
+  static void write(std::ostream& os, std::vector<GazetteerEntry> entries) {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const GazetteerEntry& a, const GazetteerEntry& b) {
+                       return a.zip < b.zip;
+                     });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const GazetteerEntry& a,
+                                 const GazetteerEntry& b) {
+                                return a.zip == b.zip;
+                              }),
+                  entries.end());
+    unsigned char header[HEADER_SIZE] = {'W', 'A', 'Z', 'G'};
+    writeU32(header + 4, VERSION);
+    writeU32(header + 8, static_cast<std::uint32_t>(entries.size()));
+    os.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+    for (const auto& entry : entries) {
+      unsigned char r[RECORD_SIZE];
+      writeU32(r, entry.zip);
+      writeU32(r + 4, static_cast<std::uint32_t>(static_cast<std::int32_t>(
+                          std::lround(entry.latitude * SCALE))));
+      writeU32(r + 8, static_cast<std::uint32_t>(static_cast<std::int32_t>(
+                          std::lround(entry.longitude * SCALE))));
+      os.write(reinterpret_cast<const char*>(r), RECORD_SIZE);
+    }
+  }
+
+ private:
+  const unsigned char* data{nullptr};
+  std::size_t length{0};
+  std::size_t count{0};
+  bool mapped_file{false};
+#ifdef _WIN32
+  std::vector<unsigned char> fallback;
+#endif
+
+  const unsigned char* record(std::size_t index) const {
+    return data + HEADER_SIZE + index * RECORD_SIZE;
+  }
+
+  static std::uint32_t readU32(const unsigned char* p) {
+    return std::uint32_t{p[0]} | std::uint32_t{p[1]} << 8 |
+           std::uint32_t{p[2]} << 16 | std::uint32_t{p[3]} << 24;
+  }
+
+  static std::int32_t readI32(const unsigned char* p) {
+    return static_cast<std::int32_t>(readU32(p));
+  }
+
+  static void writeU32(unsigned char* p, std::uint32_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+  }
+};
@@ -0,0 +1,545 @@
+// Local stand-in for api.weather.gov and the graphical.weather.gov ZIP
+// lookup, for load testing and profiling without touching the real API.
+//
+//   mock-nws-server [--port 8090] [--latency-ms 0] [--jitter-ms 0]
+//                   [--error-rate 0] [--html-error-rate 0]
+//                   [--retry-after 30] [--periods 14] [--alerts 4]
+//                   [--update-secs 0] [--replay <dir>] [--seed 1]
+//
+// Point weather-alerts at it with --api-origin http://127.0.0.1:8090. Any
+// ZIP code resolves (to a made-up point), so thousands of locations can be
+// monitored at once. Every response is delayed by --latency-ms plus up to
+// --jitter-ms, a --error-rate fraction of them fail with 503, and a
+// --html-error-rate fraction with the HTML 503 page of an overloaded CDN,
+// carrying Retry-After: --retry-after seconds. Forecast and alert
+// documents are sized by --periods and --alerts (hourly forecasts always
+// cover 156 hours). Documents change (new ETag) every --update-secs;
+// until then conditional requests get 304.
+// With --replay, responses recorded by weather-alerts --record are served
+// first for the requests they match.
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "HttpTransport.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  int port{8090};
+  int latencyMs{0};
+  int jitterMs{0};
+  double errorRate{0};
+  double htmlErrorRate{0};
+  int retryAfterSecs{30};
+  int periods{14};
+  int alerts{4};
+  int updateSecs{0};
+  std::string replayDir;
+  unsigned seed{1};
+};
+
+struct Stats {
+  long requests{0};
+  long ok{0};
+  long notModified{0};
+  long errors{0};
+  long notFound{0};
+  long replayed{0};
+  long long bytes{0};
+};
+
+// A canned response: everything up to the blank line, then the body.
+struct Document {
+  std::string head;  // Status line and headers, without Content-Length
+  std::string body;
+  std::string etag;
+};
+
+std::string forecastDocument(int periods, long generation) {
+  static const char* names[] = {"Tonight", "Saturday", "Saturday Night",
+                                "Sunday", "Sunday Night", "Monday",
+                                "Monday Night", "Tuesday"};
+  std::ostringstream os;
+  os << "{\"type\":\"Feature\",\"properties\":{\"units\":\"us\","
+     << "\"generatedAt\":\"2026-06-13T20:14:03+00:00\","
+     << "\"updateTime\":\"2026-06-13T19:" << 10 + generation % 50
+     << ":18+00:00\",\"periods\":[";
+  for (int i = 0; i < periods; i++) {
+    const bool day = i % 2 == 1;
+    const int temperature = day ? 78 + i % 9 : 58 + i % 7;
+    if (i) os << ',';
+    os << "{\"number\":" << i + 1 << ",\"name\":\"" << names[i % 8]
+       << "\",\"startTime\":\"2026-06-" << 13 + (i + 1) / 2
+       << (day ? "T06" : "T18") << ":00:00-05:00\",\"endTime\":\"2026-06-"
+       << 13 + (i + 2) / 2 << (day ? "T18" : "T06")
+       << ":00:00-05:00\",\"isDaytime\":" << (day ? "true" : "false")
+       << ",\"temperature\":" << temperature
+       << ",\"temperatureUnit\":\"F\",\"probabilityOfPrecipitation\":"
+       << "{\"unitCode\":\"wmoUnit:percent\",\"value\":" << (i * 10) % 90
+       << "},\"windSpeed\":\"5 to 10 mph\",\"windDirection\":\"SW\","
+       << "\"shortForecast\":\"Chance Showers And Thunderstorms\","
+       << "\"detailedForecast\":\"A chance of showers and thunderstorms. "
+       << (day ? "High" : "Low") << " around " << temperature
+       << ", with temperatures steady. Southwest wind 5 to 10 mph, with "
+       << "gusts as high as 20 mph. Chance of precipitation is "
+       << (i * 10) % 90 << "%. Mock generation " << generation << ".\"}";
+  }
+  os << "]}}";
+  return os.str();
+}
+
+// 156 hours from the hour it is generated in, like api.weather.gov's
+// forecastHourly, cooling through freezing on the second night.
+std::string hourlyDocument(long generation) {
+  const std::time_t now = std::time(nullptr);
+  const std::time_t first = now - now % 3600;
+  auto isoTime = [](std::time_t t) {
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S+00:00",
+                  std::gmtime(&t));
+    return std::string(buffer);
+  };
+  std::ostringstream os;
+  os << "{\"type\":\"Feature\",\"properties\":{\"units\":\"us\","
+     << "\"generatedAt\":\"" << isoTime(now) << "\",\"updateTime\":\""
+     << isoTime(first - generation % 50 * 60) << "\",\"periods\":[";
+  for (int i = 0; i < 156; i++) {
+    const std::time_t start = first + i * 3600;
+    const int hour = std::gmtime(&start)->tm_hour;
+    const bool day = hour >= 12 && hour < 24;  // Roughly daylight in CONUS
+    const int temperature = 44 - i / 6 + (day ? 12 : 0);
+    if (i) os << ',';
+    os << "{\"number\":" << i + 1 << ",\"name\":\"\",\"startTime\":\""
+       << isoTime(start) << "\",\"endTime\":\"" << isoTime(start + 3600)
+       << "\",\"isDaytime\":" << (day ? "true" : "false")
+       << ",\"temperature\":" << temperature
+       << ",\"temperatureUnit\":\"F\",\"probabilityOfPrecipitation\":"
+       << "{\"unitCode\":\"wmoUnit:percent\",\"value\":" << (i * 7) % 80
+       << "},\"dewpoint\":{\"unitCode\":\"wmoUnit:degC\",\"value\":"
+       << (temperature - 40) / 2 << "},\"relativeHumidity\":{\"unitCode\":"
+       << "\"wmoUnit:percent\",\"value\":70},\"windSpeed\":\""
+       << 5 + i % 20 << " mph\",\"windDirection\":\"NW\","
+       << "\"shortForecast\":\"Mostly Cloudy\"}";
+  }
+  os << "]}}";
+  return os.str();
+}
+
+std::string alertsDocument(int alerts, long generation) {
+  std::ostringstream os;
+  os << "{\"type\":\"FeatureCollection\",\"features\":[";
+  for (int i = 0; i < alerts; i++) {
+    if (i) os << ',';
+    os << "{\"type\":\"Feature\",\"properties\":{\"id\":\"urn:oid:mock." << i
+       << "\",\"areaDesc\":\"Mock County, ZZ\",\"geocode\":{\"UGC\":["
+       << "\"ZZC" << 100 + i % 900 << "\"]},\"affectedZones\":["
+       << "\"https://api.weather.gov/zones/county/ZZC" << 100 + i % 900
+       << "\"],\"references\":[],\"sent\":\"2026-06-13T18:00:00-05:00\","
+       << "\"expires\":\"2026-06-13T23:00:00-05:00\",\"severity\":\"Severe\","
+       << "\"event\":\"Severe Thunderstorm Warning\",\"headline\":\"Severe "
+       << "Thunderstorm Warning " << i << " issued by Mock NWS (generation "
+       << generation << ")\",\"description\":\"At 6:00 PM CDT, a severe "
+       << "thunderstorm was located over Mock County, moving east at 35 "
+       << "mph.\\n\\nHAZARD...60 mph wind gusts and quarter size hail.\\n\\n"
+       << "SOURCE...Radar indicated.\\n\\nIMPACT...Hail damage to vehicles "
+       << "is expected. Expect wind damage to roofs, siding, and trees.\"}}";
+  }
+  os << "]}";
+  return os.str();
+}
+
+// Deterministic point for a ZIP code, so the same ZIP always maps to the
+// same grid cell.
+std::string pointFor(unsigned zip) {
+  char buffer[48];
+  std::snprintf(buffer, sizeof(buffer), "%.4f,%.4f",
+                25.0 + (zip % 2400) / 100.0, -(70.0 + (zip / 2400) % 50));
+  return buffer;
+}
+
+std::string pointDocument(const std::string& point) {
+  unsigned hash = 0;
+  for (char c : point) hash = hash * 31 + static_cast<unsigned char>(c);
+  const unsigned x = hash % 200, y = (hash / 200) % 200;
+  std::ostringstream os;
+  os << "{\"type\":\"Feature\",\"properties\":{"
+     << "\"forecast\":\"https://api.weather.gov/gridpoints/MCK/" << x << ','
+     << y << "/forecast\",\"forecastHourly\":"
+     << "\"https://api.weather.gov/gridpoints/MCK/" << x << ',' << y
+     << "/forecast/hourly\",\"county\":"
+     << "\"https://api.weather.gov/zones/county/ZZC" << 100 + hash % 900
+     << "\",\"forecastZone\":\"https://api.weather.gov/zones/forecast/ZZZ"
+     << 100 + hash % 900 << "\",\"fireWeatherZone\":"
+     << "\"https://api.weather.gov/zones/fire/ZZZ" << 100 + hash % 900
+     << "\",\"relativeLocation\":{\"properties\":{\"city\":\"Mock City "
+     << x << '-' << y << "\",\"state\":\"ZZ\"}}}}";
+  return os.str();
+}
+
+class MockServer {
+ public:
+  explicit MockServer(const Options& options)
+      : options(options), random(options.seed), started(Clock::now()) {
+    if (!options.replayDir.empty()) loadReplay(options.replayDir);
+  }
+
+  void run() {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) < 0 ||
+        ::listen(listen_fd, SOMAXCONN) < 0) {
+      throw std::runtime_error("Cannot listen on 127.0.0.1:" +
+                               std::to_string(options.port) + ": " +
+                               std::strerror(errno));
+    }
+    setNonBlocking(listen_fd);
+    std::cerr << "Mock NWS API on http://127.0.0.1:" << options.port << "/";
+    if (!replay.empty()) std::cerr << " (" << replay.size() << " recorded)";
+    std::cerr << '\n';
+
+    auto nextReport = Clock::now() + std::chrono::seconds(10);
+    std::vector<pollfd> fds;
+    while (true) {
+      const auto now = Clock::now();
+      auto wake = nextReport;
+      fds.clear();
+      fds.push_back({listen_fd, POLLIN, 0});
+      for (const auto& c : connections) {
+        short events = POLLIN;
+        if (!c.out.empty()) {
+          // A response held back for latency only needs the timeout
+          if (c.readyAt <= now) {
+            events = POLLOUT;
+          } else {
+            events = 0;
+            wake = std::min(wake, c.readyAt);
+          }
+        }
+        fds.push_back({c.fd, events, 0});
+      }
+      const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+          wake - now);
+      ::poll(fds.data(), fds.size(),
+             static_cast<int>(std::max<long long>(0, timeout.count())));
+
+      for (std::size_t i = connections.size(); i-- > 0;) {
+        if (!service(connections[i], fds[i + 1].revents)) {
+          ::close(connections[i].fd);
+          connections[i] = std::move(connections.back());
+          connections.pop_back();
+        }
+      }
+      if (fds[0].revents & POLLIN) accept();
+
+      if (Clock::now() >= nextReport) {
+        report();
+        nextReport += std::chrono::seconds(10);
+      }
+    }
+  }
+
+ private:
+  struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+    std::size_t sent{0};
+    Clock::time_point readyAt{};
+    bool close{false};
+  };
+
+  const Options& options;
+  std::mt19937 random;
+  Clock::time_point started;
+  int listen_fd{-1};
+  std::vector<Connection> connections;
+  std::unordered_map<std::string, Document> replay;  // By recording name
+  Stats stats, lastStats;
+  long cachedGeneration{-1};
+  Document forecast, hourly, alerts;
+
+  static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  void loadReplay(const std::string& dir) {
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+      if (entry.path().extension() != ".http") continue;
+      std::ifstream in(entry.path(), std::ios::binary);
+      std::stringstream buffer;
+      buffer << in.rdbuf();
+      const std::string raw = buffer.str();
+      auto split = raw.find("\r\n\r\n");
+      if (split == std::string::npos) continue;
+      Document document;
+      document.head = raw.substr(0, split + 2);
+      document.body = raw.substr(split + 4);
+      auto etag = document.head.find("etag: ");
+      if (etag != std::string::npos)
+        document.etag = document.head.substr(
+            etag + 6, document.head.find("\r\n", etag) - etag - 6);
+      replay[entry.path().filename().string()] = std::move(document);
+    }
+  }
+
+  long generation() const {
+    if (options.updateSecs <= 0) return 0;
+    return std::chrono::duration_cast<std::chrono::seconds>(Clock::now() -
+                                                            started)
+               .count() /
+           options.updateSecs;
+  }
+
+  // Generated documents are rebuilt only when the generation changes.
+  void refreshDocuments() {
+    const long current = generation();
+    if (current == cachedGeneration) return;
+    cachedGeneration = current;
+    const std::string etag = "\"mock-" + std::to_string(current) + "\"";
+    const std::string head =
+        "HTTP/1.1 200 OK\r\nContent-Type: application/geo+json\r\n"
+        "Cache-Control: public, max-age=60\r\nETag: " +
+        etag + "\r\n";
+    forecast = {head, forecastDocument(options.periods, current), etag};
+    hourly = {head, hourlyDocument(current), etag};
+    alerts = {head, alertsDocument(options.alerts, current), etag};
+  }
+
+  void accept() {
+    while (true) {
+      int fd = ::accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) return;
+      setNonBlocking(fd);
+      int yes = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+      connections.push_back(Connection{fd, {}, {}, 0, {}, false});
+    }
+  }
+
+  // False once the connection should be closed.
+  bool service(Connection& c, short revents) {
+    if (revents & (POLLERR | POLLHUP | POLLNVAL) && c.out.empty())
+      return false;
+    if (c.out.empty() && (revents & POLLIN)) {
+      char buffer[4096];
+      ssize_t n = ::recv(c.fd, buffer, sizeof(buffer), 0);
+      if (n == 0) return false;
+      if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+      c.in.append(buffer, static_cast<std::size_t>(n));
+    }
+    // Answer every complete request already buffered (pipelining), but
+    // only write each one once its simulated latency has passed
+    while (true) {
+      if (c.out.empty()) {
+        auto end = c.in.find("\r\n\r\n");
+        if (end == std::string::npos) return c.in.size() < 64 * 1024;
+        respond(c, c.in.substr(0, end));
+        c.in.erase(0, end + 4);
+      }
+      if (c.readyAt > Clock::now()) return true;
+      ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent,
+                         MSG_NOSIGNAL);
+      if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+      c.sent += static_cast<std::size_t>(n);
+      stats.bytes += n;
+      if (c.sent < c.out.size()) return true;
+      c.out.clear();
+      c.sent = 0;
+      if (c.close) return false;
+    }
+  }
+
+  static std::string headerValue(const std::string& request,
+                                 const std::string& name) {
+    std::string lower = request;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char ch) { return std::tolower(ch); });
+    auto pos = lower.find("\r\n" + name + ":");
+    if (pos == std::string::npos) return "";
+    pos += name.size() + 3;
+    auto end = request.find("\r\n", pos);
+    auto begin = request.find_first_not_of(" \t", pos);
+    return request.substr(begin, end - begin);
+  }
+
+  void respond(Connection& c, const std::string& request) {
+    ++stats.requests;
+    const auto lineEnd = request.find("\r\n");
+    const std::string line = request.substr(0, lineEnd);
+    const auto pathStart = line.find(' ') + 1;
+    const std::string target =
+        line.substr(pathStart, line.find(' ', pathStart) - pathStart);
+    c.close = line.compare(line.size() - 3, 3, "1.0") == 0 ||
+              headerValue(request, "connection") == "close";
+
+    int delay = options.latencyMs;
+    if (options.jitterMs > 0)
+      delay += std::uniform_int_distribution<int>(0, options.jitterMs)(random);
+    c.readyAt = Clock::now() + std::chrono::milliseconds(delay);
+
+    if (options.errorRate > 0 &&
+        std::uniform_real_distribution<double>(0, 1)(random) <
+            options.errorRate) {
+      ++stats.errors;
+      c.out = compose(
+          {"HTTP/1.1 503 Service Unavailable\r\n"
+           "Content-Type: application/problem+json\r\n",
+           "{\"title\":\"Service Unavailable\",\"status\":503}", ""},
+          "");
+      return;
+    }
+    if (options.htmlErrorRate > 0 &&
+        std::uniform_real_distribution<double>(0, 1)(random) <
+            options.htmlErrorRate) {
+      ++stats.errors;
+      c.out = compose(
+          {"HTTP/1.1 503 Service Unavailable\r\n"
+           "Content-Type: text/html\r\nRetry-After: " +
+               std::to_string(options.retryAfterSecs) + "\r\n",
+           "<html><head><title>503 Service Unavailable</title></head>\n"
+           "<body><h1>Service Unavailable</h1></body></html>\n",
+           ""},
+          "");
+      return;
+    }
+
+    const std::string ifNoneMatch = headerValue(request, "if-none-match");
+    auto recorded = replay.find(HttpTransport::recordingName(target));
+    if (recorded != replay.end()) {
+      ++stats.replayed;
+      c.out = compose(recorded->second, ifNoneMatch);
+      return;
+    }
+
+    refreshDocuments();
+    if (target.compare(0, 7, "/points") == 0) {
+      c.out = compose({"HTTP/1.1 200 OK\r\nContent-Type: "
+                       "application/geo+json\r\n",
+                       pointDocument(target.substr(8)), ""},
+                      "");
+    } else if (target.compare(0, 11, "/gridpoints") == 0) {
+      const bool isHourly =
+          target.size() >= 7 &&
+          target.compare(target.size() - 7, 7, "/hourly") == 0;
+      c.out = compose(isHourly ? hourly : forecast, ifNoneMatch);
+    } else if (target.compare(0, 7, "/alerts") == 0) {
+      c.out = compose(alerts, ifNoneMatch);
+    } else if (target.find("listZipCodeList=") != std::string::npos) {
+      const unsigned zip = static_cast<unsigned>(std::strtoul(
+          target.c_str() + target.find('=') + 1, nullptr, 10));
+      c.out = compose({"HTTP/1.1 200 OK\r\nContent-Type: text/xml\r\n",
+                       "<?xml version=\"1.0\"?><dwml><latLonList>" +
+                           pointFor(zip) + "</latLonList></dwml>",
+                       ""},
+                      "");
+    } else {
+      ++stats.notFound;
+      c.out = compose({"HTTP/1.1 404 Not Found\r\n"
+                       "Content-Type: application/problem+json\r\n",
+                       "{\"title\":\"Not Found\",\"status\":404}", ""},
+                      "");
+    }
+  }
+
+  // Full response for `document`; 304 when `ifNoneMatch` is its ETag.
+  std::string compose(const Document& document,
+                      const std::string& ifNoneMatch) {
+    if (!document.etag.empty() && ifNoneMatch == document.etag) {
+      ++stats.notModified;
+      return "HTTP/1.1 304 Not Modified\r\nETag: " + document.etag +
+             "\r\nContent-Length: 0\r\n\r\n";
+    }
+    if (document.head.compare(9, 3, "200") == 0) ++stats.ok;
+    return document.head + "Content-Length: " +
+           std::to_string(document.body.size()) + "\r\n\r\n" + document.body;
+  }
+
+  void report() {
+    std::fprintf(stderr,
+                 "%ld requests (+%ld): %ld ok, %ld not modified, %ld errors, "
+                 "%ld not found, %ld replayed, %.1f MB sent, %zu connections\n",
+                 stats.requests, stats.requests - lastStats.requests, stats.ok,
+                 stats.notModified, stats.errors, stats.notFound,
+                 stats.replayed, stats.bytes / 1e6, connections.size());
+    lastStats = stats;
+  }
+};
+
+int main(int ac, char* av[]) {
+  Options options;
+  for (int i = 1; i < ac; i++) {
+    const std::string arg = av[i];
+    const char* value = i + 1 < ac ? av[i + 1] : nullptr;
+    if (!value) {
+      std::cerr << "Usage: see the comment at the top of mock-nws-server.cpp\n";
+      return 1;
+    }
+    ++i;
+    if (arg == "--port")
+      options.port = std::atoi(value);
+    else if (arg == "--latency-ms")
+      options.latencyMs = std::atoi(value);
+    else if (arg == "--jitter-ms")
+      options.jitterMs = std::atoi(value);
+    else if (arg == "--error-rate")
+      options.errorRate = std::atof(value);
+    else if (arg == "--html-error-rate")
+      options.htmlErrorRate = std::atof(value);
+    else if (arg == "--retry-after")
+      options.retryAfterSecs = std::atoi(value);
+    else if (arg == "--periods")
+      options.periods = std::atoi(value);
+    else if (arg == "--alerts")
+      options.alerts = std::atoi(value);
+    else if (arg == "--update-secs")
+      options.updateSecs = std::atoi(value);
+    else if (arg == "--replay")
+      options.replayDir = value;
+    else if (arg == "--seed")
+      options.seed = static_cast<unsigned>(std::atoi(value));
+    else {
+      std::cerr << "Unknown option " << arg << '\n';
+      return 1;
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  try {
+    MockServer server(options);
+    server.run();
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+// AlertIndex fan-out over fixtures/alerts-typical.json: locations get the
+// alerts of every code they subscribed, each alert once, and lose them when
+// the feed drops them. The Heat Advisory there lists forecast zones only.
+//
+//   alert-index-test [<fixtures directory>]
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../AlertIndex.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+
+std::vector<std::string> eventsOf(const std::vector<WeatherAlert>& alerts) {
+  std::vector<std::string> events;
+  for (const auto& alert : alerts) events.push_back(alert.event);
+  return events;
+}
+}  // namespace
+
+int main(int ac, char* av[]) {
+  const std::filesystem::path fixtures = ac > 1 ? av[1] : "fixtures";
+  std::ifstream in(fixtures / "alerts-typical.json", std::ios::binary);
+  if (!in) {
+    std::cerr << "Missing " << (fixtures / "alerts-typical.json") << '\n';
+    return EXIT_FAILURE;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+
+  AlertIndex index;
+  index.subscribe(0, "MNC041");  // County and forecast zone
+  index.subscribe(0, "MNZ060");
+  index.subscribe(1, "MNC041");  // County only
+  index.subscribe(2, "MNC999");  // Forecast zone only has an alert
+  index.subscribe(2, "MNZ061");
+  index.subscribe(3, "MNZ060");  // Two zones of the same alert
+  index.subscribe(3, "MNZ061");
+  index.subscribe(3, "MNZ061");  // Subscribing twice changes nothing
+  index.subscribe(4, "MNC999");  // Nothing at all
+
+  std::map<std::size_t, std::vector<std::string>> got;
+  auto collect = [&](std::size_t location, std::vector<WeatherAlert> alerts) {
+    check(!got.count(location),
+          "location " + std::to_string(location) + " delivered once");
+    got[location] = eventsOf(alerts);
+  };
+
+  index.update(bj::parse(buffer.str()));
+  check(index.alerts().size() == 5, "five alerts in the fixture");
+  index.fanOut(collect);
+  using Events = std::vector<std::string>;
+  check(got[0] == Events{"Severe Thunderstorm Warning", "Heat Advisory"},
+        "county and zone alerts, in feed order");
+  check(got[1] == Events{"Severe Thunderstorm Warning"},
+        "a county-only location doesn't get zone alerts");
+  check(got[2] == Events{"Heat Advisory"}, "a zone-only alert");
+  check(got[3] == Events{"Heat Advisory"}, "an alert is delivered once");
+  check(!got.count(4), "locations without alerts aren't visited");
+
+  // The same feed again visits the same locations
+  got.clear();
+  index.fanOut(collect);
+  check(got.size() == 4 && got[3] == Events{"Heat Advisory"},
+        "an unchanged feed");
+
+  // Everything expired: those that had alerts are told so
+  got.clear();
+  index.update(bj::parse(R"({"features": []})"));
+  index.fanOut(collect);
+  check(got.size() == 4, "four locations lose their alerts");
+  for (const auto& [location, events] : got)
+    check(events.empty(),
+          "location " + std::to_string(location) + " has no alerts left");
+
+  // And after that nobody is visited until alerts come back
+  got.clear();
+  index.fanOut(collect);
+  check(got.empty(), "nothing to deliver");
+
+  got.clear();
+  index.update(bj::parse(buffer.str()));
+  index.fanOutAll(collect);
+  check(got.size() == 5 && got[4].empty() &&
+            got[0] == Events{"Severe Thunderstorm Warning", "Heat Advisory"},
+        "fanOutAll() visits every location");
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "alert-index-test passed\n";
+  return EXIT_SUCCESS;
+}
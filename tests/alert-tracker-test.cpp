@@ -0,0 +1,114 @@
+// AlertTracker diffing of consecutive alert lists: new, updated (through
+// `references`, along a chain of updates) and expired alerts.
+//
+//   alert-tracker-test
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../AlertTracker.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+
+WeatherAlert alert(const std::string& id, const std::string& event,
+                   std::vector<std::string> references = {}) {
+  WeatherAlert a;
+  a.id = id;
+  a.event = event;
+  a.headline = event + " issued " + id;
+  a.references = std::move(references);
+  return a;
+}
+
+std::vector<std::string> idsOf(const std::vector<const WeatherAlert*>& alerts) {
+  std::vector<std::string> ids;
+  for (const auto* a : alerts) ids.push_back(a->id);
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+std::vector<std::string> idsOf(const std::vector<TrackedAlert>& alerts) {
+  std::vector<std::string> ids;
+  for (const auto& a : alerts) ids.push_back(a.id);
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+using Ids = std::vector<std::string>;
+}  // namespace
+
+int main() {
+  AlertTracker tracker;
+
+  // Everything is new at first
+  std::vector<WeatherAlert> alerts = {alert("a1", "Tornado Watch"),
+                                      alert("b1", "Flood Warning")};
+  AlertChanges changes = tracker.update(alerts);
+  check(idsOf(changes.added) == Ids{"a1", "b1"}, "first alerts are new");
+  check(changes.updated.empty() && changes.expired.empty() &&
+            changes.unchanged == 0,
+        "nothing else on the first cycle");
+  check(tracker.size() == 2, "two tracked");
+
+  // The same list again
+  changes = tracker.update(alerts);
+  check(changes.empty() && changes.unchanged == 2, "an unchanged list");
+
+  // b2 replaces b1, which is then not expired; c1 refers to an alert we
+  // never saw and is simply new
+  alerts = {alert("a1", "Tornado Watch"),
+            alert("b2", "Flood Warning", {"b1"}),
+            alert("c1", "Heat Advisory", {"x0"})};
+  changes = tracker.update(alerts);
+  check(idsOf(changes.updated) == Ids{"b2"}, "an update");
+  check(changes.updated.size() == 1 && changes.updated[0] == &alerts[1],
+        "changes point into the list given");
+  check(idsOf(changes.added) == Ids{"c1"},
+        "unknown references make a new alert");
+  check(changes.expired.empty(), "a replaced alert doesn't expire");
+  check(changes.unchanged == 1, "a1 unchanged");
+
+  // A chain: b3 lists every earlier version, only b2 is still tracked.
+  // a1 drops out without a replacement.
+  alerts = {alert("b3", "Flood Warning", {"b1", "b2"}),
+            alert("c1", "Heat Advisory", {"x0"})};
+  changes = tracker.update(alerts);
+  check(idsOf(changes.updated) == Ids{"b3"}, "an update along the chain");
+  check(changes.added.empty(), "nothing new");
+  check(idsOf(changes.expired) == Ids{"a1"}, "a1 expired");
+  check(changes.expired.size() == 1 &&
+            changes.expired[0].event == "Tornado Watch" &&
+            changes.expired[0].headline == "Tornado Watch issued a1",
+        "an expired alert keeps its event and headline");
+  check(tracker.size() == 2, "two tracked after the chain");
+
+  // An update listed next to the alert it replaces: both stay
+  alerts = {alert("b3", "Flood Warning", {"b1", "b2"}),
+            alert("b4", "Flood Warning", {"b3"}),
+            alert("c1", "Heat Advisory", {"x0"})};
+  changes = tracker.update(alerts);
+  check(idsOf(changes.updated) == Ids{"b4"} && changes.unchanged == 2 &&
+            changes.expired.empty(),
+        "an update beside the alert it replaces");
+
+  // All gone
+  changes = tracker.update({});
+  check(idsOf(changes.expired) == Ids{"b3", "b4", "c1"}, "everything expired");
+  check(changes.added.empty() && changes.updated.empty(),
+        "nothing new when everything expired");
+  check(tracker.size() == 0, "nothing tracked");
+  check(tracker.update({}).empty(), "nothing to expire twice");
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "alert-tracker-test passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+// Rule files (RuleSet) against a small, fixed forecast: the parser and its
+// errors, every window, units, NaN fields, and the hourly daytime column.
+//
+//   forecast-rules-test
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../ForecastRules.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+
+// Start of the `n`th 12-hour period from 2026-01-01 06:00 UTC.
+std::string periodStart(int n) {
+  char text[32];
+  std::snprintf(text, sizeof text, "2026-01-%02dT%02d:00:00+00:00",
+                1 + (6 + n * 12) / 24, (6 + n * 12) % 24);
+  return text;
+}
+
+ForecastPeriod period(int n, int temperature, int precipitation,
+                      const std::string& wind) {
+  ForecastPeriod p;
+  p.startTime = periodStart(n);
+  p.endTime = periodStart(n + 1);
+  p.isDaytime = n % 2 == 0;
+  p.temperature = temperature;
+  p.temperatureUnit = "F";
+  p.precipitationChance = precipitation;
+  p.windSpeed = wind;
+  return p;
+}
+
+// Whether the one-rule file "rule: <expression>" matches `data` at `now`.
+bool holds(const std::string& expression, const RuleData& data,
+           std::int64_t now) {
+  const RuleSet rules = RuleSet::parse("rule: " + expression);
+  return rules.matches(0, data, now);
+}
+
+// The message RuleSet::parse() throws for `text`, empty if it doesn't.
+std::string parseError(const std::string& text) {
+  try {
+    RuleSet::parse(text, "site.rules");
+  } catch (const std::runtime_error& e) {
+    return e.what();
+  }
+  return "";
+}
+
+// `depth` ones added up right to left, so each waits on the stack.
+std::string nested(int depth) {
+  std::string text = "1";
+  for (int i = 1; i < depth; i++) text = "1 + (" + text + ")";
+  return text;
+}
+}  // namespace
+
+int main() {
+  // Precipitation -1 and wind "" are left out by the forecast: NaN
+  const std::vector<ForecastPeriod> periods = {
+      period(0, 40, 10, "10 mph"),      period(1, 28, 70, "5 to 15 mph"),
+      period(2, 35, -1, "20 mph"),      period(3, 18, 20, ""),
+      period(4, 30, 80, "45 mph"),      period(5, 15, 0, "10 mph")};
+  RuleData data;
+  data.assign(periods);
+  check(data.size() == 6, "six periods");
+  const std::int64_t now = data.starts().front();
+  auto expect = [&](const std::string& expression, bool expected) {
+    check(holds(expression, data, now) == expected,
+          expression + (expected ? " holds" : " does not hold"));
+  };
+
+  // Windows
+  expect("max(24h, temperature) == 40", true);
+  expect("min(48h, temperature) == 18", true);
+  expect("min(72h, temperature) == 15", true);
+  expect("any(24h, precipitation >= 70)", true);
+  expect("any(24h, precipitation > 70)", false);
+  expect("all(72h, temperature < 41)", true);
+  expect("all(72h, temperature < 40)", false);
+  expect("count(48h, temperature < 30) == 2", true);
+  expect("count(72h, daytime) == 3", true);
+  expect("count(72h, daytime == 0) == 3", true);
+  expect("then(48h, precipitation >= 60, temperature <= 20)", true);
+  expect("then(48h, temperature <= 20, precipitation >= 60)", false);
+  expect("then(72h, temperature <= 20, precipitation >= 60)", true);
+  expect("max(24h, temperature) - min(24h, temperature) == 12", true);
+  expect("-min(72h, temperature) == -15", true);
+  expect("max(24h, wind) > 40 or count(72h, daytime) == 3", true);
+  expect("max(24h, wind) > 40 and count(72h, daytime) == 3", false);
+  expect("not any(24h, wind > 40)", true);
+  expect("any(24h, temperature - 30 > 5 and daytime)", true);
+
+  // Units: only d changes the value
+  expect("count(1d, temperature > 0) == 2", true);
+  expect("count(1, temperature > 0) == 1", true);
+  expect("count(3d, temperature > 0) == 6", true);
+  expect("any(24h, precipitation >= 70%)", true);
+  expect("max(24h, wind) == 15 mph", true);
+  expect("all(24h, temperature >= 28 F)", true);
+
+  // NaN never matches, and max/min skip it
+  expect("any(48h, precipitation < 5)", false);
+  expect("any(72h, precipitation < 5)", true);
+  expect("max(48h, wind) == 20", true);
+  expect("min(72h, wind) == 10", true);
+  expect("any(72h, dewpoint < 1000)", false);
+  expect("any(72h, dewpoint >= 1000)", false);
+  expect("max(72h, dewpoint) > 0", false);
+  expect("max(72h, dewpoint) <= 0", false);
+
+  // Nothing in the window at all
+  check(!holds("any(24h, temperature > 0)", data, now + 100 * 3600),
+        "an empty window matches nothing");
+
+  // Names and lines
+  const RuleSet rules = RuleSet::parse(
+      "# Site rules\n"
+      "\n"
+      "hard-freeze: count(2d, temperature < 20 F) >= 1  # overnight\n"
+      "  windy : max(24h, wind) > 40 mph\n");
+  check(rules.size() == 2, "comments and blank lines are skipped");
+  check(rules.name(0) == "hard-freeze" && rules.name(1) == "windy",
+        "rule names are trimmed");
+  check(rules.matches(0, data, now) && !rules.matches(1, data, now),
+        "rules of a file match independently");
+
+  // Errors name the source and the line
+  auto expectError = [&](const std::string& text, const std::string& start) {
+    const std::string message = parseError(text);
+    check(message.compare(0, start.size(), start) == 0,
+          "'" + text + "' fails with '" + start + "...', got '" + message +
+              "'");
+  };
+  expectError("# comment\n\nok: any(1d, wind > 1)\nbad: any(1d, bogus > 1)\n",
+              "site.rules:4: unknown name 'bogus'");
+  expectError("no colon here", "site.rules:1: expected 'name: expression'");
+  expectError(": any(1d, wind)", "site.rules:1: rule without a name");
+  expectError("a: any(1d, wind)\na: any(2d, wind)",
+              "site.rules:2: rule 'a' defined twice");
+  expectError("a: temperature > 3", "site.rules:1: 'temperature' is only");
+  expectError("a: any(1d, any(1d, wind))",
+              "site.rules:1: windows can't be nested");
+  expectError("a: any(0h, wind)",
+              "site.rules:1: window must be longer than 0 hours");
+  expectError("a: max(1d, wind) >", "site.rules:1: expected a value");
+  expectError("a: max(1d, wind) 3", "site.rules:1: unexpected '3'");
+  expectError("a: any(1d, wind", "site.rules:1: expected ')'");
+  expectError("a: then(1d, wind)", "site.rules:1: expected ','");
+  expectError("a: any(x, wind)", "site.rules:1: expected a number");
+
+  // MAX_DEPTH, for a rule and for a window's code
+  const int deepest = static_cast<int>(RuleSet::MAX_DEPTH);
+  expect(nested(deepest) + " == " + std::to_string(deepest), true);
+  expectError("a: " + nested(deepest + 1),
+              "site.rules:1: expression too deeply nested");
+  expect("any(1d, wind + (" + nested(deepest - 1) + ") > 0)", true);
+  expectError("a: any(1d, wind + (" + nested(deepest) + "))",
+              "site.rules:1: expression too deeply nested");
+
+  // Hourly data carries daytime too, from each hour's isDaytime
+  HourlyForecast hourly;
+  hourly.update(bj::parse(R"({"properties": {"periods": [
+      {"startTime": "2026-01-01T16:00:00+00:00", "isDaytime": true,
+       "temperature": 30, "temperatureUnit": "F"},
+      {"startTime": "2026-01-01T17:00:00+00:00", "isDaytime": false,
+       "temperature": 28, "temperatureUnit": "F"},
+      {"startTime": "2026-01-01T18:00:00+00:00",
+       "temperature": 27, "temperatureUnit": "F"}]}})"));
+  RuleData hourlyData;
+  hourlyData.assign(hourly);
+  const std::int64_t hourlyNow = hourlyData.starts().front();
+  check(holds("count(3h, daytime) == 1", hourlyData, hourlyNow),
+        "one daytime hour");
+  check(holds("count(3h, daytime == 0) == 1", hourlyData, hourlyNow),
+        "one night hour, and one without isDaytime that matches neither");
+  check(holds("then(3h, daytime, temperature < 29)", hourlyData, hourlyNow),
+        "daytime in then()");
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "forecast-rules-test passed\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+// Retention of HistoryStore: compactIfDue() has to drop stale snapshots on
+// its own, without an explicit compact() first.
+//
+//   history-store-test [<scratch directory>]
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "../HistoryStore.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+}  // namespace
+
+int main(int ac, char* av[]) {
+  const std::filesystem::path dir =
+      ac > 1 ? av[1] : std::filesystem::temp_directory_path();
+  const std::filesystem::path file = dir / "history-store-test.hist";
+  std::filesystem::remove(file);
+
+  const std::int64_t now = HistoryStore::now();
+  const std::int64_t day = 86400;
+  {
+    HistoryStore history;
+    check(history.open(file), "open");
+    // Ten days ago, then one every ten minutes for the last eight hours
+    for (int i = 0; i < 50; i++)
+      check(history.append(AlertSnapshot{now - 10 * day + i, "55401", {}}),
+            "append stale");
+    for (int i = 0; i < 50; i++)
+      check(history.append(AlertSnapshot{now - i * 600, "55401", {}}),
+            "append recent");
+    check(history.size() == 100, "100 snapshots before compaction");
+
+    history.setRetention(std::chrono::hours(24));
+    check(history.compactIfDue(now), "compactIfDue");
+    check(history.size() == 50, "stale snapshots dropped");
+    check(history.oldest() >= now - day, "nothing older than the retention");
+
+    // Not due again within COMPACT_INTERVAL, even with new stale data
+    check(history.append(AlertSnapshot{now - 5 * day, "55401", {}}),
+          "append stale again");
+    check(history.compactIfDue(now + 60) && history.size() == 51,
+          "no second compaction within the interval");
+    check(history.compactIfDue(now + HistoryStore::COMPACT_INTERVAL) &&
+              history.size() == 50,
+          "compacts again after the interval");
+  }
+
+  // Reopening sees the compacted file, and no temporary file is left
+  HistoryStore reopened;
+  check(reopened.open(file, true) && reopened.size() == 50, "reopen");
+  check(!std::filesystem::exists(file.string() + ".tmp"), "no temp file");
+  std::filesystem::remove(file);
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "history-store-test passed\n";
+  return EXIT_SUCCESS;
+}
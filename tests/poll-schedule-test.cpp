@@ -0,0 +1,210 @@
+// PollSchedule delays and the header parsing they rest on: backoff bounds
+// per consecutive failure, jitter after a success, Retry-After, HTTP dates
+// and max-age/Expires freshness.
+//
+//   poll-schedule-test
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../HttpClient.hpp"
+#include "../PollSchedule.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+
+using std::chrono::seconds;
+using Duration = PollSchedule::Duration;
+
+HttpResponse response(long status,
+                      std::map<std::string, std::string> headers = {}) {
+  HttpResponse r;
+  r.status = status;
+  r.headers = std::move(headers);
+  return r;
+}
+
+// Whether `d` lies in [low, high] seconds.
+bool within(Duration d, double low, double high) {
+  const double s = std::chrono::duration<double>(d).count();
+  return s >= low && s <= high;
+}
+
+long long freshFor(const std::map<std::string, std::string>& headers) {
+  auto fresh = freshnessLifetime(response(200, headers));
+  return fresh ? fresh->count() : -1;
+}
+}  // namespace
+
+int main() {
+  // HTTP dates
+  check(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777LL,
+        "the RFC 9110 example date");
+  check(parseHttpDate("Mon, 29 Feb 2016 00:00:00 GMT") == 1456704000LL,
+        "a leap day");
+  check(!parseHttpDate(""), "an empty date");
+  check(!parseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT"), "an unknown month");
+  check(!parseHttpDate("Sun, 06 eb 1994 08:49:37 GMT"),
+        "a month that is part of another");
+  check(!parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT"),
+        "the obsolete RFC 850 format");
+  check(!parseHttpDate("Sun, 06 Nov 1994 08:49"), "a truncated date");
+
+  // Freshness: max-age less Age, then Expires less Date
+  const std::string date = "Sun, 06 Nov 1994 08:49:37 GMT";
+  const std::string twoMinutesLater = "Sun, 06 Nov 1994 08:51:37 GMT";
+  check(freshFor({}) == -1, "no freshness information");
+  check(freshFor({{"cache-control", "max-age=300"}}) == 300, "max-age");
+  check(freshFor({{"cache-control", "public, max-age=300"}, {"age", "100"}}) ==
+            200,
+        "max-age less Age");
+  check(freshFor({{"cache-control", "max-age=60"}, {"age", "100"}}) == 0,
+        "older than max-age");
+  check(freshFor({{"cache-control", "s-maxage=600, max-age=60"}}) == 60,
+        "s-maxage is skipped");
+  check(freshFor({{"cache-control", "s-maxage=600"}}) == -1,
+        "s-maxage alone says nothing");
+  check(freshFor({{"cache-control", "max-age"}}) == -1,
+        "max-age without a value");
+  check(freshFor({{"cache-control", "no-cache"}}) == 0, "no-cache");
+  check(freshFor({{"cache-control", "no-store, max-age=60"}}) == 0,
+        "no-store wins over max-age");
+  check(freshFor({{"expires", twoMinutesLater}, {"date", date}}) == 120,
+        "Expires less Date");
+  check(freshFor({{"expires", twoMinutesLater},
+                  {"date", date},
+                  {"age", "30"}}) == 90,
+        "Expires less Date and Age");
+  check(freshFor({{"expires", date}, {"date", twoMinutesLater}}) == 0,
+        "already expired");
+  check(freshFor({{"cache-control", "max-age=10"},
+                  {"expires", twoMinutesLater},
+                  {"date", date}}) == 10,
+        "max-age wins over Expires");
+  check(freshFor({{"expires", "0"}}) == -1, "an invalid Expires");
+
+  // Retry-After only counts on 429 and 503
+  auto after = [](long status, std::map<std::string, std::string> headers) {
+    auto delay = retryAfter(response(status, std::move(headers)));
+    return delay ? delay->count() : -1;
+  };
+  check(after(429, {{"retry-after", "120"}}) == 120, "delta seconds");
+  check(after(503, {{"retry-after", twoMinutesLater}, {"date", date}}) == 120,
+        "an HTTP date, against Date");
+  check(after(503, {{"retry-after", date}, {"date", twoMinutesLater}}) == 0,
+        "a date in the past");
+  check(after(500, {{"retry-after", "120"}}) == -1, "ignored on a 500");
+  check(after(429, {}) == -1, "no Retry-After");
+  check(after(429, {{"retry-after", "soon"}}) == -1, "an invalid Retry-After");
+
+  // Backoff from a 60 s retry delay up to a 600 s interval, with equal
+  // jitter: failure n waits between half and all of min(600, 60 * 2^(n-1))
+  const Duration retry = seconds(60), interval = seconds(600);
+  const HttpResponse timeout = response(0);
+  for (int trial = 0; trial < 200; trial++) {
+    PollSchedule schedule;
+    double full = 60;
+    for (int n = 1; n <= 40; n++) {
+      const Duration d = schedule.afterFailure(timeout, ErrorCause::TIMEOUT,
+                                               retry, interval);
+      if (!within(d, full / 2, full)) {
+        check(false, "failure " + std::to_string(n) + " waits " +
+                         std::to_string(std::chrono::duration<double>(d)
+                                            .count()) +
+                         " s, not within [" + std::to_string(full / 2) +
+                         ", " + std::to_string(full) + "]");
+        break;
+      }
+      full = std::min(full * 2, 600.0);
+    }
+    check(schedule.consecutiveFailures() == 40, "failures are counted");
+    // A success starts over
+    schedule.afterSuccess(response(200), interval);
+    check(schedule.consecutiveFailures() == 0, "a success resets");
+    check(within(schedule.afterFailure(timeout, ErrorCause::TIMEOUT, retry,
+                                       interval),
+                 30, 60),
+          "backoff starts over after a success");
+  }
+
+  for (int trial = 0; trial < 200; trial++) {
+    PollSchedule schedule;
+    // Client errors wait for the normal interval, server errors back off
+    check(within(schedule.afterFailure(response(404), ErrorCause::HTTP_STATUS,
+                                       retry, interval),
+                 300, 600),
+          "a 404 waits for the interval");
+    PollSchedule serverError;
+    check(within(serverError.afterFailure(response(502),
+                                          ErrorCause::HTTP_STATUS, retry,
+                                          interval),
+                 30, 60),
+          "a 502 backs off");
+    // Retry-After is a lower bound only
+    PollSchedule limited;
+    check(limited.afterFailure(response(429, {{"retry-after", "900"}}),
+                               ErrorCause::HTTP_STATUS, retry,
+                               interval) == seconds(900),
+          "a long Retry-After is honored");
+    check(within(limited.afterFailure(response(429, {{"retry-after", "1"}}),
+                                      ErrorCause::HTTP_STATUS, retry,
+                                      interval),
+                 60, 120),
+          "a short Retry-After doesn't cut the backoff");
+    // A retry delay longer than the interval is the ceiling
+    PollSchedule slow;
+    check(within(slow.afterFailure(timeout, ErrorCause::TIMEOUT,
+                                   seconds(900), interval),
+                 450, 900),
+          "the retry delay caps itself");
+
+    // Success: the interval or the freshness lifetime, plus up to 10%
+    PollSchedule ok;
+    check(within(ok.afterSuccess(response(200), interval), 600, 660),
+          "interval plus jitter");
+    check(within(ok.afterSuccess(response(200, {{"cache-control",
+                                                 "max-age=1200"}}),
+                                 interval),
+                 1200, 1320),
+          "a longer max-age stretches the interval");
+    check(within(ok.afterSuccess(response(200, {{"cache-control",
+                                                 "max-age=60"}}),
+                                 interval),
+                 600, 660),
+          "a shorter max-age doesn't shorten it");
+
+    // next(): a transfer that went fine failed on its data
+    PollSchedule data;
+    check(within(data.next(response(200), true, ErrorCause::JSON_SYNTAX,
+                           interval, retry),
+                 30, 60),
+          "bad data backs off");
+    HttpResponse notFound = response(404);
+    notFound.error = "HTTP 404";
+    notFound.cause = ErrorCause::HTTP_STATUS;
+    check(within(data.next(notFound, true, ErrorCause::JSON_SYNTAX, interval,
+                           retry),
+                 300, 600),
+          "next() uses the transfer's cause");
+  }
+
+  // Start-up offsets: 25 ms apart, at most a minute, plus up to 250 ms
+  check(within(PollSchedule::startupOffset(0), 0, 0.25), "first offset");
+  check(within(PollSchedule::startupOffset(40), 1, 1.25), "fortieth offset");
+  check(within(PollSchedule::startupOffset(100000), 60, 60.25),
+        "offsets stop at a minute");
+
+  check(describeDelay(seconds(45)) == "45 seconds", "seconds");
+  check(describeDelay(seconds(420)) == "7 minutes", "minutes");
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "poll-schedule-test passed\n";
+  return EXIT_SUCCESS;
+}
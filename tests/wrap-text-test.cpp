@@ -0,0 +1,77 @@
+// WeatherData::wrapText at the edges of the width, with words longer than
+// a line, embedded newlines, blank lines and multibyte characters.
+//
+//   wrap-text-test
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../WeatherData.hpp"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+  if (ok) return;
+  std::cerr << "FAILED: " << what << '\n';
+  ++failures;
+}
+
+std::string wrap(const std::string& input, std::size_t width) {
+  std::string out;
+  WeatherData::wrapText(input, width, out);
+  return out;
+}
+
+void expect(const std::string& input, std::size_t width,
+            const std::string& expected) {
+  const std::string got = wrap(input, width);
+  check(got == expected, "wrapping '" + input + "' to " +
+                             std::to_string(width) + " gave '" + got +
+                             "', expected '" + expected + "'");
+}
+}  // namespace
+
+int main() {
+  // Lines stay shorter than the width: 9 columns fit in 10, 10 don't
+  expect("aaaa bbbb", 10, "aaaa bbbb\n");
+  expect("aaaa bbbbb", 10, "aaaa\nbbbbb\n");
+  expect("aaaa bbbb cc dd", 10, "aaaa bbbb\ncc dd\n");
+  expect("a b c d", 4, "a b\nc d\n");
+
+  // A word longer than a line gets a line of its own, unbroken
+  expect("verylongword", 5, "verylongword\n");
+  expect("a verylongword b", 5, "a\nverylongword\nb\n");
+  expect("a b", 0, "a\nb\n");
+  expect("a b", 1, "a\nb\n");
+
+  // Runs of spaces and tabs collapse; CR of CRLF is dropped
+  expect("  one \t  two  ", 80, "one two\n");
+  expect("one\r\ntwo\r\n", 80, "one\ntwo\n");
+
+  // Input lines are wrapped on their own
+  expect("one\ntwo", 80, "one\ntwo\n");
+  expect("aaaa bbbb\ncc", 10, "aaaa bbbb\ncc\n");
+  expect("aaaa bbbbb\ncc dd", 10, "aaaa\nbbbbb\ncc dd\n");
+
+  // Blank lines: one between paragraphs, none at the ends
+  expect("one\n\n\n  \ntwo", 80, "one\n\ntwo\n");
+  expect("\n\none\n\n", 80, "one\n");
+  expect("", 80, "");
+  expect("\n \n", 80, "");
+
+  // Code points, not bytes, are counted
+  expect("\xc3\xa9\xc3\xa9\xc3\xa9 \xc3\xa9\xc3\xa9\xc3\xa9", 8,
+         "\xc3\xa9\xc3\xa9\xc3\xa9 \xc3\xa9\xc3\xa9\xc3\xa9\n");
+  expect("\xc3\xa9\xc3\xa9\xc3\xa9 \xc3\xa9\xc3\xa9\xc3\xa9", 7,
+         "\xc3\xa9\xc3\xa9\xc3\xa9\n\xc3\xa9\xc3\xa9\xc3\xa9\n");
+
+  // Output is appended
+  std::string out = "Alert:\n";
+  WeatherData::wrapText("one two", 80, out);
+  check(out == "Alert:\none two\n", "appends to the output");
+
+  if (failures) return EXIT_FAILURE;
+  std::cout << "wrap-text-test passed\n";
+  return EXIT_SUCCESS;
+}
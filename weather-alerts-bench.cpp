@@ -0,0 +1,323 @@
+// Micro-benchmarks for the parse/render hot path, run against the NWS
+// payloads in fixtures/.
+//
+//   weather-alerts-bench [--fixtures <dir>] [--filter <text>] [--min-ms <n>]
+//
+// Every stage is repeated until it has run for at least --min-ms (default
+// 200) and reported as time, heap allocations and heap bytes per operation.
+// Allocations are counted by replacing the global operator new, so they
+// include everything the stage does, not only JSON parsing. Stages with an
+// allocation budget (ALLOCATION_BUDGETS) fail the run, exit status 1, when
+// they allocate more per operation than that.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AlertIndex.hpp"
+#include "ForecastRules.hpp"
+#include "HourlyForecast.hpp"
+#include "ParseArena.hpp"
+#include "WeatherData.hpp"
+#include "WeatherSettings.hpp"
+
+#ifndef WEATHER_ALERTS_FIXTURES
+#define WEATHER_ALERTS_FIXTURES "fixtures"
+#endif
+
+namespace {
+std::size_t allocationCount = 0;
+std::size_t allocationBytes = 0;
+
+void* countedAllocate(std::size_t n) {
+  ++allocationCount;
+  allocationBytes += n;
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void* countedAllocate(std::size_t n, std::align_val_t align) {
+  ++allocationCount;
+  allocationBytes += n;
+  std::size_t alignment = static_cast<std::size_t>(align);
+  // aligned_alloc wants a size that is a multiple of the alignment
+  std::size_t size = (n + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+  if (void* p = _aligned_malloc(size ? size : alignment, alignment)) return p;
+#else
+  if (void* p = std::aligned_alloc(alignment, size ? size : alignment))
+    return p;
+#endif
+  throw std::bad_alloc();
+}
+
+void alignedFree(void* p) {
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+}  // namespace
+
+void* operator new(std::size_t n) { return countedAllocate(n); }
+void* operator new[](std::size_t n) { return countedAllocate(n); }
+void* operator new(std::size_t n, std::align_val_t a) {
+  return countedAllocate(n, a);
+}
+void* operator new[](std::size_t n, std::align_val_t a) {
+  return countedAllocate(n, a);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  alignedFree(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+  alignedFree(p);
+}
+
+namespace {
+// Accepts and drops everything, so rendering is measured without the cost
+// of growing an output buffer.
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Keeps results alive so the optimizer can't drop the work.
+volatile std::size_t sink = 0;
+
+// Most allocations per operation a stage may make once warmed up: a poll's
+// documents fit the grown arena, the render path wraps into reused
+// buffers, and textWrap() allocates only its result.
+const std::map<std::string, double> ALLOCATION_BUDGETS = {
+    {"ParseArena parse", 0},
+    {"printAlerts", 0},
+    {"wrapText (reused)", 0},
+    {"textWrap", 1},
+};
+// Set by bench() when a stage exceeds its budget
+bool overBudget = false;
+
+struct Options {
+  std::filesystem::path fixtures{WEATHER_ALERTS_FIXTURES};
+  std::string filter;
+  long minMs{200};
+};
+
+std::string readFixture(const Options& options, const std::string& name) {
+  std::ifstream in(options.fixtures / name, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Missing fixture " +
+                             (options.fixtures / name).string());
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+void bench(const Options& options, const std::string& stage,
+           const std::string& fixture, const std::function<void()>& op) {
+  const std::string name = stage + " " + fixture;
+  if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+    return;
+
+  using Clock = std::chrono::steady_clock;
+  op();  // Warm up caches and lazily built state
+  std::size_t iterations = 1;
+  while (true) {
+    allocationCount = allocationBytes = 0;
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < iterations; i++) op();
+    const auto elapsed = Clock::now() - start;
+    const std::size_t allocations = allocationCount;
+    const std::size_t bytes = allocationBytes;
+    if (elapsed >= std::chrono::milliseconds(options.minMs) ||
+        iterations >= (std::size_t{1} << 30)) {
+      const double n = static_cast<double>(iterations);
+      std::printf("%-24s %-10s %12.0f %12.1f %14.0f %10zu\n", stage.c_str(),
+                  fixture.c_str(),
+                  std::chrono::duration<double, std::nano>(elapsed).count() /
+                      n,
+                  allocations / n, bytes / n, iterations);
+      auto budget = ALLOCATION_BUDGETS.find(stage);
+      if (budget != ALLOCATION_BUDGETS.end() &&
+          allocations / n > budget->second) {
+        std::fprintf(stderr, "%s %s: %.1f allocs/op, budget is %.0f\n",
+                     stage.c_str(), fixture.c_str(), allocations / n,
+                     budget->second);
+        overBudget = true;
+      }
+      return;
+    }
+    iterations *= 2;
+  }
+}
+}  // namespace
+
+int main(int ac, char* av[]) {
+  Options options;
+  for (int i = 1; i < ac; i++) {
+    const std::string arg = av[i];
+    if (arg == "--fixtures" && i + 1 < ac) {
+      options.fixtures = av[++i];
+    } else if (arg == "--filter" && i + 1 < ac) {
+      options.filter = av[++i];
+    } else if (arg == "--min-ms" && i + 1 < ac) {
+      options.minMs = std::atol(av[++i]);
+    } else {
+      std::cerr << "Usage: " << av[0]
+                << " [--fixtures <dir>] [--filter <text>] [--min-ms <n>]\n";
+      return 1;
+    }
+  }
+
+  try {
+    const std::string forecast = readFixture(options, "forecast.json");
+    const std::vector<std::pair<std::string, std::string>> feeds = {
+        {"small", readFixture(options, "alerts-small.json")},
+        {"typical", readFixture(options, "alerts-typical.json")},
+        {"outbreak", readFixture(options, "alerts-outbreak.json")}};
+
+    std::printf("%-24s %-10s %12s %12s %14s %10s\n", "stage", "fixture",
+                "ns/op", "allocs/op", "bytes/op", "iterations");
+
+    for (const auto& [name, alerts] : feeds) {
+      bench(options, "WeatherData", name, [&] {
+        WeatherData data(forecast, alerts, true);
+        sink = sink + data.getAlerts().size();
+      });
+    }
+
+    // How the monitor parses a poll: one arena per location, reused. The
+    // warm-up poll outgrows the arena (the outbreak feed is far over its
+    // initial 64 KiB), after which every poll must fit.
+    for (const auto& [name, alerts] : feeds) {
+      ParseArena arena;
+      bench(options, "ParseArena parse", name, [&] {
+        {
+          bj::stream_parser& parser = arena.parser(0);
+          parser.write(alerts);
+          parser.finish();
+          const bj::value document = parser.release();
+          sink = sink + document.as_object().size();
+        }
+        arena.release();  // Its documents are gone, as in the monitor
+      });
+      if (arena.lastPollAllocations() != 0) {
+        std::fprintf(stderr, "ParseArena %s: %zu allocations in a warm poll\n",
+                     name.c_str(), arena.lastPollAllocations());
+        overBudget = true;
+      }
+    }
+
+    WeatherData typical(forecast, feeds[1].second, true);
+    const std::size_t periodCount = typical.getPeriods().size();
+    std::size_t period = 0;
+    bench(options, "getForecastForPeriod", "typical", [&] {
+      sink = sink + typical.getForecastForPeriod(
+                        static_cast<int>(period++ % periodCount))
+                        .size();
+    });
+
+    const std::string& detailed =
+        typical.getPeriods().front().detailedForecast;
+    const std::string& description =
+        typical.getAlerts().front().description;
+    bench(options, "textWrap", "forecast", [&] {
+      sink = sink + typical.textWrap(detailed).size();
+    });
+    bench(options, "textWrap", "alert", [&] {
+      sink = sink + typical.textWrap(description).size();
+    });
+    std::string wrapped;
+    bench(options, "wrapText (reused)", "alert", [&] {
+      wrapped.clear();
+      WeatherData::wrapText(description, 80, wrapped);
+      sink = sink + wrapped.size();
+    });
+
+    NullBuffer nullBuffer;
+    std::ostream null(&nullBuffer);
+    for (const auto& [name, alerts] : feeds) {
+      WeatherData data(forecast, alerts, true);
+      bench(options, "printAlerts", name, [&] { data.printAlerts(null); });
+    }
+
+    // The national feed is indexed once per cycle for every location
+    for (const auto& [name, alerts] : feeds) {
+      const bj::value document = bj::parse(alerts);
+      AlertIndex index;
+      bench(options, "AlertIndex update", name, [&] {
+        index.update(document);
+        sink = sink + index.zones();
+      });
+    }
+
+    const bj::value hourlyDocument =
+        bj::parse(readFixture(options, "forecast-hourly.json"));
+    HourlyForecast hourly;
+    bench(options, "hourly update", "hourly", [&] {
+      hourly.update(hourlyDocument);
+      sink = sink + hourly.size();
+    });
+    // One outlook per location per cycle, as the report computes it
+    const std::int64_t start = hourly.times().front();
+    bench(options, "hourly outlook", "hourly", [&] {
+      sink = sink + hourly.outlook(start, WeatherData::OUTLOOK_HOURS).hours;
+    });
+    const HourlyForecast::Range all{0, hourly.size()};
+    bench(options, "hourly firstAbove", "hourly", [&] {
+      // No hour is that windy, so every element is checked
+      sink = sink + HourlyForecast::firstAbove(hourly.windSpeeds(), all, 200);
+    });
+
+    // A thousand rules per location per poll, against either kind of data
+    std::string ruleText;
+    for (int i = 0; i < 1000; i++)
+      ruleText += "rule" + std::to_string(i) + ": max(24h, wind) > " +
+                  std::to_string(20 + i % 30) +
+                  " or then(48h, precipitation >= 60, temperature <= " +
+                  std::to_string(30 + i % 5) + ")\n";
+    const RuleSet rules = RuleSet::parse(ruleText);
+    RuleData hourlyRules, periodRules;
+    hourlyRules.assign(hourly);
+    periodRules.assign(typical.getPeriods());
+    for (const auto* data : {&hourlyRules, &periodRules}) {
+      const std::int64_t now = data->starts().front();
+      bench(options, "rules x1000",
+            data == &hourlyRules ? "hourly" : "forecast", [&] {
+              std::size_t matched = 0;
+              for (std::size_t i = 0; i < rules.size(); i++)
+                matched += rules.matches(i, *data, now);
+              sink = sink + matched;
+            });
+    }
+
+    WeatherSettings settings(options.fixtures / "settings.json");
+    bench(options, "loadSettings", "settings", [&] {
+      settings.loadSettings();
+      sink = sink + settings.getZipCodes().size();
+    });
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return overBudget ? 1 : 0;
+}
@@ -1,53 +1,69 @@
 #include <chrono>
 #include <iostream>
 #include <optional>
-#include <regex>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "CommandLineProcessor.hpp"
+#include "ForecastRules.hpp"
+#include "HistoryStore.hpp"
 #include "HttpClient.hpp"
+#include "HourlyForecast.hpp"
+#include "HttpTransport.hpp"
+#include "LocationCache.hpp"
+#include "Metrics.hpp"
+#include "OutputFrame.hpp"
+#include "PollSchedule.hpp"
+#include "SnapshotServer.hpp"
+#include "SnapshotStore.hpp"
+#include "TimerQueue.hpp"
 #include "WeatherData.hpp"
+#include "WeatherError.hpp"
 #include "WeatherLocation.hpp"
+#include "WeatherMonitor.hpp"
 #include "WeatherSettings.hpp"
+#include "ZipGazetteer.hpp"
 namespace fs = std::filesystem;
 
-std::string getCurrentTimeStamp() {
-  // Get the current time point
-  auto now = std::chrono::system_clock::now();
-  // Convert to a time_t
-  std::time_t current_time = std::chrono::system_clock::to_time_t(now);
-  // Convert to local time
-  std::tm* local_tm = std::localtime(&current_time);
-  char timeBuffer[32];
-  std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%b-%d %H:%M:%S", local_tm);
-
-  return static_cast<std::string>(timeBuffer);
-}
-
 std::string getValidZipCode(CommandLineProcessor& clp,
                             WeatherSettings& settings) {
   std::string zipCode = clp.getZipCode();
-  std::regex zipCodeTest("^\\d{5,5}$");
-
   if (zipCode == "00000" && settings.settingsFileExists()) {
     zipCode = settings.getZipCode();
   }
-  if (zipCode == "00000" || !std::regex_search(zipCode, zipCodeTest)) {
+  if (zipCode == "00000" || !isValidZipCode(zipCode)) {
     do {
       std::cout << "Enter ZIP code: ";
       std::cin >> zipCode;
-    } while (zipCode == "00000" || !std::regex_search(zipCode, zipCodeTest));
+    } while (zipCode == "00000" || !isValidZipCode(zipCode));
   }
 
-  if (!std::regex_search(zipCode, zipCodeTest)) {
+  if (!isValidZipCode(zipCode)) {
     throw std::invalid_argument("Invalid ZIP code.");
   }
 
   return zipCode;
 }
 
+// ZIP codes to monitor concurrently: --zipcodes wins, otherwise the list
+// saved in settings.json is used unless a single ZIP code was given.
+std::vector<std::string> getZipCodeList(CommandLineProcessor& clp,
+                                        WeatherSettings& settings) {
+  std::vector<std::string> zipCodes = clp.getZipCodes();
+  if (zipCodes.empty() && clp.getZipCode() == "00000" &&
+      settings.settingsFileExists()) {
+    zipCodes = settings.getZipCodes();
+  }
+  for (const auto& zipCode : zipCodes) {
+    if (!isValidZipCode(zipCode)) {
+      throw std::invalid_argument("Invalid ZIP code: " + zipCode);
+    }
+  }
+  return zipCodes;
+}
+
 void displayConfiguration(CommandLineProcessor& clp,
                           WeatherSettings& settings) {
   std::stringstream oss;
@@ -88,10 +104,10 @@ void initializeVariables(std::string& zipCode, int& delay, int& retry,
 void processCommandLineArgs(int ac, char* av[],
                             std::optional<CommandLineProcessor>& clp,
                             WeatherSettings& settings, std::string& zipCode,
-                            int& delay, int& retry, int& forecastPeriods,
+                            std::vector<std::string>& zipCodes, int& delay, int& retry, int& forecastPeriods,
                             std::string& forecast_api, std::string& alerts_api,
                             std::string& city, std::string& state) {
-  clp.emplace(ac, av);
+  if (!clp) clp.emplace(ac, av);
   delay = clp->getDefaultRefreshDelay();
   retry = clp->getDefaultRetryDelay();
   forecastPeriods = clp->getDefaultForecastPeriods();
@@ -101,13 +117,16 @@ void processCommandLineArgs(int ac, char* av[],
     exit(1);
   }
 
-  zipCode = getValidZipCode(*clp, settings);
+  zipCodes = getZipCodeList(*clp, settings);
+  zipCode =
+      zipCodes.empty() ? getValidZipCode(*clp, settings) : zipCodes.front();
   if (settings.settingsFileExists()) {
     delay = settings.getDelay();
     retry = settings.getRetry();
     forecastPeriods = settings.getPeriods();
     // if the zipCode is the same as settings.json then the data is correct.
-    // if forecast_api is left blank, new location will be retrieved.
+    // if forecast_api is left blank, the location cache is consulted and
+    // only a ZIP code missing there is retrieved again.
     if (zipCode == settings.getZipCode()) {
       forecast_api = settings.getForecastAPI();
       alerts_api = settings.getAlertsAPI();
@@ -118,97 +137,355 @@ void processCommandLineArgs(int ac, char* av[],
 
   displayConfiguration(*clp, settings);
   if (clp->hasDelay()) delay = clp->getDelay();
+  if (clp->hasForecastInterval()) delay = clp->getForecastInterval();
   if (clp->hasRetry()) retry = clp->getRetry();
+  if (clp->hasAlertInterval())
+    settings.setAlertInterval(clp->getAlertInterval());
   if (clp->hasForecastPeriods()) forecastPeriods = clp->getForecastPeriods();
 
   settings.setZipCode(zipCode);
+  settings.setZipCodes(zipCodes);
   settings.setDelay(delay);
   settings.setRetry(retry);
   settings.setForecastPeriods(forecastPeriods);
 }
 
+// Endpoints for `zipCode`, from the cache when it has a fresh entry and
+// from a WeatherLocation lookup (which is then cached) otherwise. The
+// gazetteer is only opened for the first lookup, so cached runs never map
+// it.
+CachedLocation resolveLocation(const std::string& zipCode,
+                               LocationCache& locationCache,
+                               std::optional<ZipGazetteer>& gazetteer,
+                               const fs::path& gazetteerFile) {
+  if (auto cached = locationCache.find(zipCode)) return *cached;
+  if (!gazetteer) gazetteer.emplace(gazetteerFile);
+  WeatherLocation myLocation(zipCode, &*gazetteer);
+  CachedLocation location;
+  location.forecastAPI = myLocation.getForecastAPI();
+  location.alertsAPI = myLocation.getAlertsAPI();
+  location.city = myLocation.getCity();
+  location.state = myLocation.getState();
+  location.alertZones = myLocation.getAlertZones();
+  locationCache.insert(zipCode, location);
+  return location;
+}
+
 void setupWeatherLocation(const std::string& zipCode, std::string& forecast_api,
                           std::string& alerts_api, std::string& city,
-                          std::string& state, WeatherSettings& settings) {
+                          std::string& state, WeatherSettings& settings,
+                          LocationCache& locationCache,
+                          std::optional<ZipGazetteer>& gazetteer,
+                          bool persist) {
   if (forecast_api.empty()) {
-    WeatherLocation myLocation(zipCode);
-    forecast_api = myLocation.getForecastAPI();
-    alerts_api = myLocation.getAlertsAPI();
-    city = myLocation.getCity();
-    state = myLocation.getState();
+    CachedLocation location =
+        resolveLocation(zipCode, locationCache, gazetteer,
+                        settings.getGazetteerFile());
+    forecast_api = location.forecastAPI;
+    alerts_api = location.alertsAPI;
+    city = location.city;
+    state = location.state;
     settings.setForecastAPI(forecast_api);
     settings.setAlertsAPI(alerts_api);
     settings.setCity(city);
     settings.setState(state);
+  } else if (!locationCache.find(zipCode)) {
+    // Carry the location resolved by older versions over into the cache
+    locationCache.insert(zipCode, {forecast_api, alerts_api, city, state, 0, {}});
   }
-  settings.saveSettings();
+  if (persist) settings.saveSettings();
+  locationCache.save();
 }
 
-void displayWeatherLoop(WeatherSettings& settings,
-                        const std::string& forecast_api,
-                        const std::string& alerts_api, bool wordWrap) {
+// Polls until killed or, with `once`, exactly once; then returns the exit
+// status.
+int displayWeatherLoop(WeatherSettings& settings,
+                       const MonitoredLocation& location, bool wordWrap,
+                       bool timing, bool allAlerts, OutputFormat format,
+                       const fs::path& metricsFile, HistoryStore* history,
+                       const RuleSet* rules, bool once) {
+  // Forecast and alerts run on their own timers so alerts can be checked
+  // far more often than the forecast is refreshed.
+  enum Feed : std::size_t { FORECAST, ALERTS };
+  const std::string& forecast_api = location.forecast_api;
+  const std::string& alerts_api = location.alerts_api;
+  const std::string& hourly_api = location.hourly_api;
   HttpClient httpClient;
+  ParseArena arena;
+  LocationReport report(wordWrap, allAlerts, format);
+  report.useRules(rules);
+  Metrics metrics;
+  describeMetrics(metrics);
+  // Each cycle is rendered here first and written with one write per stream
+  OutputFrame output(stdout);
+  OutputFrame errors(stderr);
+  TimerQueue timers;
+  PollSchedule forecastSchedule, alertsSchedule;
+  timers.schedule(FORECAST, TimerQueue::Clock::now());
+  timers.schedule(ALERTS, TimerQueue::Clock::now());
   while (true) {
+    std::this_thread::sleep_until(*timers.nextDue());
+    bool pollForecast = false, pollAlerts = false;
+    while (auto feed = timers.popDue(TimerQueue::Clock::now())) {
+      (*feed == FORECAST ? pollForecast : pollAlerts) = true;
+    }
+    const bool forecastPolled = pollForecast, alertsPolled = pollAlerts;
+
+    // The hourly forecast, when used, comes with every forecast poll
+    const bool pollHourly = pollForecast && !hourly_api.empty();
+    std::vector<std::string> urls;
+    if (pollForecast) urls.push_back(forecast_api);
+    if (pollHourly) urls.push_back(hourly_api);
+    if (pollAlerts) urls.push_back(alerts_api);
+    bool forecastFailed = false, alertsFailed = false, applied = false;
+    std::string error;
+    ErrorCause dataCause = ErrorCause::OTHER;
+    std::vector<HttpResponse> responses;
     try {
-      std::cout << "Run: \t\t" << getCurrentTimeStamp() << "\n";
-
-      std::string rawData = httpClient.get(forecast_api);
-      std::string rawAlerts = httpClient.get(alerts_api);
-
-      WeatherData weatherData(rawData, rawAlerts, wordWrap);
-      std::cout << weatherData.getGeneratedTime() << "\n";
-      std::cout << weatherData.getUpdateTime() << "\n\n";
-      weatherData.printAlerts();
-
-      // Display the forecast for the next x periods
-      const int NUM_FORECAST_PERIODS = settings.getPeriods();
-      for (int i = 0; i < NUM_FORECAST_PERIODS; i++) {
-        std::cout << weatherData.getForecastForPeriod(i);
-        if (i != NUM_FORECAST_PERIODS - 1) std::cout << "\n";
+      // Last poll's documents are gone; recycle their memory in one go
+      arena.release();
+      // Due requests run at the same time and are parsed while they
+      // download; rendering waits for all of them.
+      responses = httpClient.fetchAll(urls, true, &arena);
+      HttpResponse* forecast = pollForecast ? &responses.front() : nullptr;
+      HttpResponse* hourly = pollHourly ? &responses[1] : nullptr;
+      HttpResponse* alerts = pollAlerts ? &responses.back() : nullptr;
+      forecastFailed =
+          (forecast && !forecast->ok()) || (hourly && !hourly->ok());
+      alertsFailed = alerts && !alerts->ok();
+      for (std::size_t i = 0; i < urls.size(); i++)
+        recordRequest(metrics, urls[i], location.zipCode, responses[i]);
+
+      // Unchanged (304) feeds reuse the data parsed on an earlier run and
+      // alerts already shown are not repeated
+      const HttpResponse* failed = report.apply(
+          forecast, alerts, settings.getPeriods(),
+          "Run: \t\t" + getCurrentTimeStamp() + "\n", output.out(), hourly);
+      applied = true;
+      if (history && !recordHistory(*history, location.zipCode, report,
+                                    forecast, alerts))
+        errors.out() << "Could not write history\n";
+      if (timing && pollForecast) {
+        errors.out() << httpClient.connectionReport() << "\n";
+        errors.out() << "Parse arena: " << arena.capacity() / 1024
+                     << " KiB, heap allocations last poll: "
+                     << arena.lastPollAllocations() << "\n";
+        if (forecast->ok())
+          errors.out() << "Forecast request: "
+                       << HttpClient::timingReport(forecast->timing) << "\n";
       }
-
-      std::cout << "---\n";
-      std::this_thread::sleep_for(std::chrono::minutes(settings.getDelay()));
-
+      // Whatever did arrive has been shown; retry the failed feed early
+      if (failed) throw WeatherError(failed->cause, failed->error);
     } catch (const std::exception& e) {
-      if (static_cast<std::string>(e.what()).substr(0, 12) == "out of range") {
-        std::cerr << "weather.gov API unavailable. ";
-      } else if (static_cast<std::string>(e.what()).substr(0,12) == "syntax error"){
-        std::cerr << "Bad JSON data. weather.gov API down. This is unusual. ";
-      } else {
-        std::cerr << "Error: " << e.what() << "\n";
+      recordError(metrics, e);
+      error = describeWeatherError(e);
+      if (!forecastFailed && !alertsFailed) {
+        // Bad data: start over with full downloads of both feeds
+        report.reset();
+        httpClient.forgetValidators(forecast_api);
+        httpClient.forgetValidators(alerts_api);
+        httpClient.forgetValidators(hourly_api);
+        pollForecast = pollAlerts = forecastFailed = alertsFailed = true;
+        dataCause = classifyError(e);
       }
+    }
+
+    const HttpResponse none;
+    const bool fetched = !responses.empty();
+    const HttpResponse& forecast =
+        forecastPolled && fetched ? responses.front() : none;
+    // A failed hourly forecast is retried as part of the forecast
+    const HttpResponse& forecastOutcome =
+        pollHourly && fetched && !responses[1].ok() ? responses[1] : forecast;
+    const HttpResponse& alerts =
+        alertsPolled && fetched ? responses.back() : none;
+    const auto now = TimerQueue::Clock::now();
+    const auto retry = std::chrono::minutes(settings.getRetry());
+    TimerQueue::Clock::duration retryIn = TimerQueue::Clock::duration::max();
+    if (pollForecast) {
+      auto delay = forecastSchedule.next(
+          forecastOutcome, forecastFailed, dataCause,
+          std::chrono::minutes(settings.getDelay()), retry);
+      timers.schedule(FORECAST, now + delay);
+      if (forecastFailed) retryIn = std::min(retryIn, delay);
+    }
+    if (pollAlerts) {
+      auto delay = alertsSchedule.next(
+          alerts, alertsFailed, dataCause,
+          std::chrono::minutes(settings.getAlertInterval()), retry);
+      timers.schedule(ALERTS, now + delay);
+      if (alertsFailed) retryIn = std::min(retryIn, delay);
+    }
+
+    if (format == OutputFormat::NDJSON)
+      report.writeRecord(output.out(), location, forecastPolled,
+                         alertsPolled, error);
+    else if (once && !error.empty())
+      errors.out() << error << (error.back() == '\n' ? "" : "\n");
+    else if (!error.empty())
+      errors.out() << error << "Retrying in " << describeDelay(retryIn)
+                   << ". . .\n";
+    if (applied) recordReport(metrics, location.zipCode, report);
+    if (!metricsFile.empty() && !metrics.writeFile(metricsFile))
+      errors.out() << "Could not write metrics to " << metricsFile.string()
+                   << "\n";
+    output.flush();
+    errors.flush();
+    if (once) return error.empty() ? 0 : 1;
+  }
+}
 
-      const int RETRY_DELAY_MINUTES = settings.getRetry();
-      std::cerr << "Retrying in " << RETRY_DELAY_MINUTES << " minutes. . .\n";
-      std::this_thread::sleep_for(std::chrono::minutes(
-          RETRY_DELAY_MINUTES));  // Wait for x minutes before retrying on
-                                  // error
+// Resolves every ZIP code to its forecast/alerts endpoints. ZIP codes in
+// the location cache cost no network requests. Returns the exit status
+// after polling each location once with `once`; never returns otherwise.
+int displayMultiLocationLoop(const std::vector<std::string>& zipCodes,
+                              WeatherSettings& settings,
+                              LocationCache& locationCache,
+                              std::optional<ZipGazetteer>& gazetteer,
+                              bool wordWrap,
+                              bool allAlerts, bool hourly, int servePort,
+                              OutputFormat format,
+                              const fs::path& metricsFile,
+                              HistoryStore* history, const RuleSet* rules,
+                              bool once, bool nationalAlerts) {
+  WeatherMonitor monitor(settings, wordWrap, allAlerts, format);
+  monitor.useRules(rules);
+  if (nationalAlerts) monitor.useNationalAlerts();
+  if (!metricsFile.empty()) monitor.exportMetrics(metricsFile);
+  monitor.keepHistory(history);
+  for (const auto& zipCode : zipCodes) {
+    MonitoredLocation location;
+    location.zipCode = zipCode;
+    try {
+      CachedLocation resolved =
+          resolveLocation(zipCode, locationCache, gazetteer,
+                          settings.getGazetteerFile());
+      location.forecast_api = resolved.forecastAPI;
+      location.alerts_api = resolved.alertsAPI;
+      location.city = resolved.city;
+      location.state = resolved.state;
+      location.alert_zones = resolved.alertZones;
+      if (hourly)
+        location.hourly_api = hourlyForecastUrl(resolved.forecastAPI);
+    } catch (const std::exception& e) {
+      std::cerr << "Skipping " << zipCode << ": " << e.what() << '\n';
+      continue;
+    } catch (const std::string& e) {
+      std::cerr << "Skipping " << zipCode << ": " << e << '\n';
+      continue;
     }
+    std::cout << "Weather for: \t" << location.city << ", " << location.state
+              << " (" << zipCode << ")\n";
+    monitor.addLocation(location);
+  }
+  locationCache.save();
+  if (!monitor.size()) {
+    throw std::runtime_error("No ZIP code could be resolved.");
+  }
+
+  if (once) return monitor.runOnce() ? 1 : 0;
+
+  // The store and server outlive run(), which never returns normally
+  std::optional<SnapshotStore> snapshots;
+  std::optional<SnapshotServer> server;
+  if (servePort) {
+    snapshots.emplace(monitor.size());
+    monitor.publishTo(&*snapshots);
+    server.emplace(*snapshots, servePort);
+    server->start();
+    std::cout << "Serving on: \thttp://127.0.0.1:" << servePort << "/\n";
   }
+  monitor.run();
+  return 0;
 }
 
 int main(int ac, char* av[]) {
+  const auto started = std::chrono::steady_clock::now();
   try {
+    std::optional<CommandLineProcessor> clp;
+    clp.emplace(ac, av);
+    const OutputFormat format = parseOutputFormat(clp->getOutput());
+    // NDJSON records own stdout; everything else goes to stderr
+    if (format == OutputFormat::NDJSON) std::cout.rdbuf(std::cerr.rdbuf());
+
     std::cout << "Version:" << '\t' << GIT_VERSION << '\n';
     std::string zipCode, forecast_api, alerts_api, city, state;
+    std::vector<std::string> zipCodes;
     int delay, retry, forecastPeriods;
-    std::optional<CommandLineProcessor> clp;
     WeatherSettings settings;
 
     initializeVariables(zipCode, delay, retry, forecastPeriods, forecast_api,
                         alerts_api, city, state, settings);
 
-    processCommandLineArgs(ac, av, clp, settings, zipCode, delay, retry,
-                           forecastPeriods, forecast_api, alerts_api, city,
-                           state);
+    processCommandLineArgs(ac, av, clp, settings, zipCode, zipCodes, delay,
+                           retry, forecastPeriods, forecast_api, alerts_api,
+                           city, state);
 
+    if (clp->hasApiOrigin()) HttpTransport::redirectTo(clp->getApiOrigin());
+    if (clp->hasRecord()) HttpTransport::recordTo(clp->getRecordDirectory());
+    if (clp->hasSharedCache())
+      HttpTransport::shareCacheIn(clp->getSharedCacheDirectory());
+
+    // Locations resolved by a mock API must not end up in the real settings
+    // or location cache
+    const bool persist = !clp->hasApiOrigin();
+
+    // Missing or invalid gazetteer files just mean network lookups
+    std::optional<ZipGazetteer> gazetteer;
+    LocationCache locationCache(persist ? settings.getLocationCacheFile()
+                                        : fs::path());
+    locationCache.load();
     setupWeatherLocation(zipCode, forecast_api, alerts_api, city, state,
-                         settings);
+                         settings, locationCache, gazetteer, persist);
+
+    const fs::path metricsFile =
+        clp->hasMetrics() ? fs::path(clp->getMetricsFile()) : fs::path();
+
+    std::optional<HistoryStore> history;
+    if (clp->hasHistory()) {
+      history.emplace();
+      if (!history->open(clp->getHistoryFile()))
+        throw std::runtime_error("Cannot open history file " +
+                                 clp->getHistoryFile());
+      history->setRetention(std::chrono::hours(24) * clp->getHistoryDays());
+    }
+    HistoryStore* historyStore = history ? &*history : nullptr;
+
+    // Compiled once; a mistake in the file stops here, not mid-poll
+    std::optional<RuleSet> rules;
+    if (clp->hasRules()) rules = RuleSet::load(clp->getRulesFile());
+    const RuleSet* ruleSet = rules ? &*rules : nullptr;
+
+    const bool once = clp->getOnce();
+    if (clp->getTiming())
+      std::cerr << "Startup: "
+                << std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - started)
+                           .count() /
+                       1000.0
+                << " ms\n";
+
+    // Serving and the national alert feed always go through the monitor;
+    // a single pass has nothing to serve
+    if (zipCodes.size() > 1 || (clp->hasServe() && !once) ||
+        clp->getNationalAlerts()) {
+      if (zipCodes.empty()) zipCodes.push_back(zipCode);
+      return displayMultiLocationLoop(
+          zipCodes, settings, locationCache, gazetteer, clp->getWordWrap(),
+          clp->getAllAlerts(), clp->getHourly(),
+          clp->hasServe() && !once ? clp->getServePort() : 0, format,
+          metricsFile, historyStore, ruleSet, once,
+          clp->getNationalAlerts());
+    }
 
     std::cout << "Weather for: \t" << city << ", " << state << '\n';
 
-    displayWeatherLoop(settings, forecast_api, alerts_api, clp->getWordWrap());
+    MonitoredLocation location{
+        zipCode, city, state, forecast_api, alerts_api,
+        clp->getHourly() ? hourlyForecastUrl(forecast_api) : "", {}};
+    return displayWeatherLoop(settings, location, clp->getWordWrap(),
+                              clp->getTiming(), clp->getAllAlerts(), format,
+                              metricsFile, historyStore, ruleSet, once);
 
   } catch (const std::exception& e) {
     std::cerr << "Unhandled exception: " << e.what() << '\n';
@@ -0,0 +1,149 @@
+// Queries and compacts the history file written by weather-alerts --history.
+//
+//   weather-history <file> [--zip <zip>] [--from <time>] [--to <time>]
+//                   [--period <name>] [--alerts] [--at <time>]
+//                   [--compact <days>] [--stats]
+//
+// Without --alerts or --at it lists every forecast stored for --zip (all
+// ZIP codes by default) between --from and --to, one line per period;
+// --period keeps only periods whose name contains the text, so
+// "--period Saturday" shows how Saturday's forecast changed. --alerts lists
+// the alert lists stored in the range instead, and --at the alerts that
+// were active at one time. Times are "2026-06-13" (midnight UTC) or ISO 8601
+// like "2026-06-13T18:00:00-05:00". --compact drops everything older than
+// the given number of days.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include "CivilTime.hpp"
+#include "HistoryStore.hpp"
+
+std::optional<std::int64_t> parseTime(std::string text) {
+  if (text.size() == 10) text += "T00:00:00Z";
+  auto seconds = parseIsoTime(text);
+  if (!seconds) return std::nullopt;
+  return *seconds;
+}
+
+std::string formatTime(std::int64_t seconds) {
+  const std::time_t t = static_cast<std::time_t>(seconds);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%SZ",
+                std::gmtime(&t));
+  return buffer;
+}
+
+void printAlerts(const AlertSnapshot& snapshot) {
+  const std::string prefix =
+      formatTime(snapshot.observed) + "  " + snapshot.location + "  ";
+  if (snapshot.alerts.empty()) std::cout << prefix << "no active alerts\n";
+  for (const auto& alert : snapshot.alerts)
+    std::cout << prefix << alert.event << " (" << alert.severity
+              << ") until " << alert.expires << '\n';
+}
+
+int usage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " <file> [--zip <zip>] [--from <time>] [--to <time>]"
+               " [--period <name>] [--alerts] [--at <time>]"
+               " [--compact <days>] [--stats]\n";
+  return 1;
+}
+
+int main(int ac, char* av[]) {
+  if (ac < 2) return usage(av[0]);
+  std::string zip, period;
+  std::int64_t from = std::numeric_limits<std::int64_t>::min();
+  std::int64_t to = std::numeric_limits<std::int64_t>::max();
+  std::optional<std::int64_t> at;
+  int compactDays = -1;
+  bool alerts = false, stats = false;
+  for (int i = 2; i < ac; i++) {
+    const std::string arg = av[i];
+    const bool hasValue = i + 1 < ac;
+    std::optional<std::int64_t> time;
+    if (arg == "--zip" && hasValue) {
+      zip = av[++i];
+    } else if (arg == "--period" && hasValue) {
+      period = av[++i];
+    } else if ((arg == "--from" || arg == "--to" || arg == "--at") &&
+               hasValue) {
+      if (!(time = parseTime(av[++i]))) {
+        std::cerr << "Not a time: " << av[i] << '\n';
+        return 1;
+      }
+      (arg == "--from" ? from : arg == "--to" ? to : at.emplace()) = *time;
+    } else if (arg == "--compact" && hasValue) {
+      compactDays = std::atoi(av[++i]);
+    } else if (arg == "--alerts") {
+      alerts = true;
+    } else if (arg == "--stats") {
+      stats = true;
+    } else {
+      return usage(av[0]);
+    }
+  }
+
+  // Read-only unless compacting, so a file being written is left alone
+  HistoryStore history;
+  if (!history.open(av[1], compactDays < 0)) {
+    std::cerr << "Error opening history file " << av[1] << ".\n";
+    return 1;
+  }
+
+  if (compactDays >= 0) {
+    const std::size_t before = history.bytes();
+    if (!history.compact(HistoryStore::now() - compactDays * 86400LL)) {
+      std::cerr << "Error compacting " << av[1] << ".\n";
+      return 1;
+    }
+    std::cout << "Compacted " << before << " to " << history.bytes()
+              << " bytes.\n";
+    return 0;
+  }
+
+  if (stats) {
+    std::cout << history.size() << " snapshots, " << history.bytes()
+              << " bytes";
+    if (history.size())
+      std::cout << ", " << formatTime(history.oldest()) << " to "
+                << formatTime(history.newest());
+    std::cout << '\n';
+    return 0;
+  }
+
+  if (at) {
+    if (auto snapshot = history.alertsAt(zip, *at))
+      printAlerts(*snapshot);
+    else
+      std::cout << "No alerts recorded before " << formatTime(*at) << ".\n";
+    return 0;
+  }
+
+  if (alerts) {
+    for (const auto& snapshot : history.alerts(zip, from, to))
+      printAlerts(snapshot);
+    return 0;
+  }
+
+  for (const auto& snapshot : history.forecasts(zip, from, to)) {
+    for (const auto& p : snapshot.periods) {
+      if (!period.empty() && p.name.find(period) == std::string::npos)
+        continue;
+      std::cout << formatTime(snapshot.observed) << "  " << snapshot.location
+                << "  " << p.name << ": " << p.temperature
+                << p.temperatureUnit;
+      if (p.precipitationChance >= 0)
+        std::cout << ", " << p.precipitationChance << "% precipitation";
+      std::cout << ", wind " << p.windSpeed << ' ' << p.windDirection << ", "
+                << p.shortForecast << '\n';
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Builds the binary ZIP gazetteer read by ZipGazetteer.
+//
+//   zip-gazetteer <input> <output>
+//
+// The input is a delimited text table with a header row, e.g. the Census
+// ZCTA gazetteer (tab separated, columns GEOID/INTPTLAT/INTPTLONG) or a
+// plain "zip,lat,lon" CSV. Columns are found by name; tabs and commas are
+// both accepted as separators.
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ZipGazetteer.hpp"
+
+std::vector<std::string> splitRow(const std::string& line, char separator) {
+  std::vector<std::string> fields;
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, separator)) {
+    // Trim whitespace and the CR of CRLF files
+    auto begin = field.find_first_not_of(" \t\r\"");
+    auto end = field.find_last_not_of(" \t\r\"");
+    fields.push_back(begin == std::string::npos
+                         ? std::string()
+                         : field.substr(begin, end - begin + 1));
+  }
+  return fields;
+}
+
+int findColumn(const std::vector<std::string>& header,
+               const std::vector<std::string>& names) {
+  for (std::size_t i = 0; i < header.size(); i++) {
+    std::string column = header[i];
+    std::transform(column.begin(), column.end(), column.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (std::find(names.begin(), names.end(), column) != names.end())
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+int main(int ac, char* av[]) {
+  if (ac != 3) {
+    std::cerr << "Usage: " << av[0] << " <input table> <output file>\n";
+    return 1;
+  }
+  std::ifstream in(av[1]);
+  if (!in) {
+    std::cerr << "Error opening " << av[1] << " for reading.\n";
+    return 1;
+  }
+
+  std::string line;
+  std::getline(in, line);
+  const char separator = line.find('\t') != std::string::npos ? '\t' : ',';
+  auto header = splitRow(line, separator);
+  int zipColumn = findColumn(header, {"geoid", "zip", "zipcode", "zcta5"});
+  int latColumn = findColumn(header, {"intptlat", "lat", "latitude"});
+  int lonColumn =
+      findColumn(header, {"intptlong", "lon", "lng", "long", "longitude"});
+  if (zipColumn < 0 || latColumn < 0 || lonColumn < 0) {
+    std::cerr << "Input needs ZIP, latitude and longitude columns.\n";
+    return 1;
+  }
+
+  std::vector<GazetteerEntry> entries;
+  std::size_t lineNumber = 1, skipped = 0;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    auto fields = splitRow(line, separator);
+    const auto needed =
+        static_cast<std::size_t>(std::max({zipColumn, latColumn, lonColumn}));
+    if (fields.size() <= needed) {
+      if (!line.empty()) ++skipped;
+      continue;
+    }
+    try {
+      const std::string& zip = fields[zipColumn];
+      if (zip.size() != 5 ||
+          !std::all_of(zip.begin(), zip.end(),
+                       [](unsigned char c) { return std::isdigit(c); }))
+        throw std::invalid_argument("bad ZIP");
+      entries.push_back({static_cast<std::uint32_t>(std::stoul(zip)),
+                         std::stod(fields[latColumn]),
+                         std::stod(fields[lonColumn])});
+    } catch (const std::exception&) {
+      std::cerr << "Skipping line " << lineNumber << ": " << line << '\n';
+      ++skipped;
+    }
+  }
+
+  std::ofstream out(av[2], std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::cerr << "Error opening " << av[2] << " for writing.\n";
+    return 1;
+  }
+  ZipGazetteer::write(out, entries);
+  if (!out) {
+    std::cerr << "Error writing " << av[2] << ".\n";
+    return 1;
+  }
+  std::cout << "Wrote " << entries.size() << " ZIP codes to " << av[2];
+  if (skipped) std::cout << " (" << skipped << " lines skipped)";
+  std::cout << '\n';
+  return 0;
+}